@@ -0,0 +1,154 @@
+#pragma once
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+// Compact binary segmentation masks, 1 = OBJ and 0 = BKG.
+//
+// BitMask stores one bit per pixel in node order (pixel x+y*width is bit i&7 of byte i>>3),
+// which is exactly what OneCut::runpacked() and the solvers' packed label export write.
+// RLEMask stores the same mask as alternating run lengths in node order, i.e. row-major, starting
+// with a (possibly empty) run of BKG pixels. COCO RLE runs column-major, transpose the mask first.
+//
+//		BitMask bits;  onecut.run(bits);   savePBM(bits, "result.pbm");
+//		RLEMask rle;   onecut.run(rle);    saveRLE(rle, "result.rle");
+
+class BitMask
+{
+public:
+	BitMask(int width = 0, int height = 0) {resize(width, height);}
+	void resize(int width, int height) {
+		m_width = width; m_height = height;
+		m_bits.assign(((size_t)width*height+7)/8, 0);
+	}
+	int getWidth() const {return m_width;}
+	int getHeight() const {return m_height;}
+	size_t getBytes() const {return m_bits.size();}
+	unsigned char * data() {return m_bits.empty() ? NULL : &m_bits[0];}
+	const unsigned char * data() const {return m_bits.empty() ? NULL : &m_bits[0];}
+
+	bool get(int x, int y) const {size_t i = x+(size_t)y*m_width; return (m_bits[i>>3]>>(i&7))&1;}
+	void set(int x, int y, bool v) {
+		size_t i = x+(size_t)y*m_width;
+		if (v) m_bits[i>>3] |= (1<<(i&7)); else m_bits[i>>3] &= ~(1<<(i&7));
+	}
+	// number of OBJ pixels
+	int count() const {
+		int c = 0;
+		for (size_t i=0; i<m_bits.size(); i++) c += __builtin_popcount(m_bits[i]);
+		return c;
+	}
+private:
+	int m_width, m_height;
+	std::vector<unsigned char> m_bits;
+};
+
+class RLEMask
+{
+public:
+	RLEMask(int width = 0, int height = 0) : m_width(width), m_height(height) {}
+	int getWidth() const {return m_width;}
+	int getHeight() const {return m_height;}
+	// runs alternate BKG, OBJ, BKG, ... and sum up to width*height
+	const std::vector<unsigned> & getRuns() const {return m_runs;}
+	std::vector<unsigned> & getRuns() {return m_runs;}
+
+	// encodes a bit mask, whole bytes of 0x00 or 0xFF extend the current run without looking at bits
+	void encode(const BitMask & bits) {
+		m_width = bits.getWidth(); m_height = bits.getHeight();
+		m_runs.clear();
+		const size_t n = (size_t)m_width*m_height;
+		const unsigned char * b = bits.data();
+		unsigned char current = 0; // value of the run in progress
+		unsigned run = 0;
+		size_t i = 0;
+		while (i < n) {
+			if ((i&7)==0 && i+8 <= n && b[i>>3] == (current ? 0xFF : 0x00)) {
+				run += 8; i += 8;
+				continue;
+			}
+			unsigned char v = (b[i>>3]>>(i&7))&1;
+			if (v != current) {
+				m_runs.push_back(run);
+				run = 0;
+				current = v;
+			}
+			run++; i++;
+		}
+		m_runs.push_back(run);
+	}
+	void decode(BitMask & bits) const {
+		bits.resize(m_width, m_height);
+		unsigned char * b = bits.data();
+		size_t i = 0;
+		for (size_t r=0; r<m_runs.size(); i+=m_runs[r], r++) {
+			if ((r&1)==0) continue; // BKG runs are already 0
+			for (size_t j=i; j<i+m_runs[r]; j++) b[j>>3] |= (1<<(j&7));
+		}
+	}
+	// number of OBJ pixels
+	int count() const {
+		int c = 0;
+		for (size_t r=1; r<m_runs.size(); r+=2) c += m_runs[r];
+		return c;
+	}
+private:
+	int m_width, m_height;
+	std::vector<unsigned> m_runs;
+};
+
+// binary PBM (P4), OBJ pixels are black: rows are padded to whole bytes, most significant bit first
+inline bool savePBM(const BitMask & mask, const char * filename)
+{
+	FILE * f = fopen(filename, "wb");
+	if (f == NULL) return false;
+	const int w = mask.getWidth(), h = mask.getHeight();
+	fprintf(f, "P4\n%d %d\n", w, h);
+	std::vector<unsigned char> row((w+7)/8);
+	const unsigned char * b = mask.data();
+	for (int y=0; y<h; y++) {
+		memset(&row[0], 0, row.size());
+		for (int x=0; x<w; x++) {
+			size_t i = x+(size_t)y*w;
+			if ((b[i>>3]>>(i&7))&1) row[x>>3] |= (0x80>>(x&7));
+		}
+		fwrite(&row[0], 1, row.size(), f);
+	}
+	return (fclose(f) == 0);
+}
+
+// text RLE: "RLE width height numruns" on the first line, then the runs separated by spaces
+inline bool saveRLE(const RLEMask & mask, FILE * f)
+{
+	const std::vector<unsigned> & runs = mask.getRuns();
+	fprintf(f, "RLE %d %d %d\n", mask.getWidth(), mask.getHeight(), (int)runs.size());
+	for (size_t r=0; r<runs.size(); r++) fprintf(f, (r+1<runs.size()) ? "%u " : "%u\n", runs[r]);
+	return !ferror(f);
+}
+inline bool saveRLE(const RLEMask & mask, const char * filename)
+{
+	FILE * f = fopen(filename, "w");
+	if (f == NULL) return false;
+	bool ok = saveRLE(mask, f);
+	return (fclose(f) == 0) && ok;
+}
+inline bool loadRLE(RLEMask & mask, const char * filename)
+{
+	FILE * f = fopen(filename, "r");
+	if (f == NULL) return false;
+	int w, h, n;
+	bool ok = (fscanf(f, "RLE %d %d %d", &w, &h, &n) == 3) && (w >= 0) && (h >= 0) && (n >= 0);
+	if (ok) {
+		mask = RLEMask(w, h);
+		std::vector<unsigned> & runs = mask.getRuns();
+		runs.resize(n);
+		size_t total = 0;
+		for (int r=0; r<n && ok; r++) {
+			ok = (fscanf(f, "%u", &runs[r]) == 1);
+			total += runs[r];
+		}
+		ok = ok && (total == (size_t)w*h);
+	}
+	fclose(f);
+	return ok;
+}
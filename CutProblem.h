@@ -0,0 +1,359 @@
+#pragma once
+#include <limits.h>
+#include <vector>
+#include <utility>
+#include "ibfs/ibfs.h"
+#include "maxflow/graph.h"
+
+// Integer form (IBFS units) of a binary cut energy: t-links per node and symmetric n-links.
+// Hard constraints are t-links of INT_MAX.
+struct CutEdge
+{
+	CutEdge(int p_ = 0, int q_ = 0, int cap_ = 0) : p(p_), q(q_), cap(cap_) {}
+	int p, q;
+	int cap; // in both directions
+};
+
+struct CutProblem
+{
+	int numnodes;
+	std::vector<int> capsource, capsink;
+	std::vector<CutEdge> edges;
+
+	void resize(int n) {
+		numnodes = n;
+		capsource.assign(n, 0);
+		capsink.assign(n, 0);
+		edges.clear();
+	}
+	bool isfixed(int n) const {return (capsource[n] == INT_MAX) || (capsink[n] == INT_MAX);}
+};
+
+// Connected components of the free nodes: every n-link of positive capacity between two free nodes joins
+// them (union-find by size with path halving). component[n] is the component of a free node, numbered in
+// order of their first node, -1 for fixed nodes. Returns the number of components.
+inline int findcomponents(const CutProblem & cp, std::vector<int> & component);
+
+// Solves a cut problem as its components, one IBFS graph each and in parallel (OpenMP). The n-links to fixed
+// nodes are folded into t-links (see PartitionedCut) and free nodes go to the source side, i.e. the maximal
+// min cut. label[n] is 1 on the source side, 0 on the sink side. Returns the value of the cut (the max flow
+// of the whole problem), numcomponents (if given) is set to the number of components.
+inline long long solvecomponents(const CutProblem & cp, std::vector<unsigned char> & label, int * numcomponents = NULL);
+
+// Persistency reduction: a free node whose source t-link is at least its sink t-link plus the capacities of
+// all its n-links is on the source side of the maximal min cut, one whose sink t-link exceeds the source
+// t-link plus its n-links on the sink side. Such nodes are fixed, their n-links to free nodes folded into
+// the t-links of those, which may fix them in turn (a queue until nothing changes). The free nodes left form
+// the residual problem, built into an IBFSGraph or a BK Graph<> (nets t-links, clips them to int).
+// The maximal min cut of the residual expands to the maximal min cut of the whole problem.
+//
+//		ReducedCut reduced;
+//		reduced.reduce(problem);
+//		IBFSGraph g(IBFSGraph::IB_INIT_FAST);
+//		reduced.build(g);                                 // node i of g is reduced.getNodes()[i]
+//		g.initGraph(); g.computeMaxFlow(true);
+//		long long flow = g.getFlow()+reduced.getOffset();  // max flow of the whole problem
+//		reduced.expand([&](int i){ return g.isNodeOnSrcSide(i,1)!=0; }, label);
+class ReducedCut
+{
+public:
+	void reduce(const CutProblem & cp);
+
+	// the residual problem
+	int getNumNodes() const {return (int)nodes.size();}
+	int getNumEdges() const {return (int)edges.size();}
+	const int * getNodes() const {return nodes.empty() ? NULL : &nodes[0];}
+	// what was eliminated: fixed nodes (with a hard constraint or by persistency) and n-links not in the residual
+	int getNumEliminatedNodes() const {return problem->numnodes-getNumNodes();}
+	int getNumEliminatedEdges() const {return (int)problem->edges.size()-getNumEdges();}
+	int getNumPersistent() const {return numpersistent;} // fixed by persistency
+	// value of the cut outside of the residual graph: its max flow plus this one is the max flow of the whole problem
+	long long getOffset() const {return offset;}
+
+	// into an empty IBFSGraph, or a graph with its interface (PushRelabelGraph)
+	template <class IBFSLike>
+	void build(IBFSLike & g) const;
+	template <class captype, class tcaptype, class flowtype>
+	void build(Graph<captype,tcaptype,flowtype> & g) const; // g is empty and has room for the residual
+	// labels of all nodes (1 source side, 0 sink side), onsource(i) tells the side of residual node i
+	template <class OnSource>
+	void expand(OnSource onsource, std::vector<unsigned char> & label) const;
+
+private:
+	const CutProblem * problem;
+	std::vector<signed char> fixed; // 1 source side, 0 sink side, -1 free
+	std::vector<int> nodes, local; // residual nodes, index of a node in the residual (-1 if fixed)
+	std::vector<int> edges; // residual n-links (indices into problem->edges)
+	std::vector<long long> foldsource, foldsink; // t-links with the n-links to fixed nodes folded
+	std::vector<int> adjstart, adj; // incident n-links of every node
+	std::vector<int> queue;
+	int numpersistent;
+	long long offset;
+
+	// net t-link of residual node i, clipped to int
+	long long net(int i) const {
+		long long v = foldsource[nodes[i]]-foldsink[nodes[i]];
+		return std::max(std::min(v, (long long)INT_MAX), -(long long)INT_MAX);
+	}
+};
+
+// Splits a cut problem into independent subproblems (parts). part[n] >= 0 puts node n into that part,
+// nodes with part[n] < 0 are not solved. An n-link between node p of part k and a node q outside of
+// part k is folded into the t-link of p, to the source if onsource(q,k) (q is OBJ as seen from part k),
+// to the sink otherwise. Only n-links inside a part become arcs of its graph.
+//
+//		PartitionedCut parts;
+//		parts.split(problem, part, numparts, onsource);
+//		for (int k=0; k<parts.getNumParts(); k++) {
+//			IBFSGraph g(IBFSGraph::IB_INIT_FAST);
+//			parts.build(k, g, extrasource);          // node i of g is parts.getNodes(k)[i]
+//			g.initGraph(); g.computeMaxFlow(true);
+//		}
+class PartitionedCut
+{
+public:
+	template <class OnSource>
+	void split(const CutProblem & cp, const std::vector<int> & part, int numparts, OnSource onsource);
+
+	int getNumParts() const {return (int)nodestart.size()-1;}
+	int getNumNodes(int k) const {return nodestart[k+1]-nodestart[k];}
+	const int * getNodes(int k) const {return &nodes[0]+nodestart[k];}
+	int getNumEdges(int k) const {return edgestart[k+1]-edgestart[k];}
+
+	// builds part k into an empty graph, extrasource[n] (if given) is added to the source t-link of node n
+	void build(int k, IBFSGraph & g, const int * extrasource = NULL) const;
+
+private:
+	const CutProblem * problem;
+	std::vector<int> nodestart, nodes; // nodes of part k are nodes[nodestart[k]..nodestart[k+1])
+	std::vector<int> local; // index of a node inside its part
+	std::vector<int> edgestart, edges; // n-links inside part k (indices into problem->edges)
+	std::vector<long long> foldsource, foldsink; // t-links with the folded n-links
+};
+
+template <class OnSource>
+void PartitionedCut::split(const CutProblem & cp, const std::vector<int> & part, int numparts, OnSource onsource)
+{
+	problem = &cp;
+	const int n = cp.numnodes;
+	// nodes of each part by counting sort, in increasing node order
+	nodestart.assign(numparts+1, 0);
+	for (int i=0; i<n; i++) if (part[i] >= 0) nodestart[part[i]+1]++;
+	for (int k=0; k<numparts; k++) nodestart[k+1] += nodestart[k];
+	nodes.resize(nodestart[numparts]);
+	local.assign(n, -1);
+	std::vector<int> fill(nodestart.begin(), nodestart.end()-1);
+	for (int i=0; i<n; i++) if (part[i] >= 0) {
+		local[i] = fill[part[i]]-nodestart[part[i]];
+		nodes[fill[part[i]]++] = i;
+	}
+
+	foldsource.resize(n);
+	foldsink.resize(n);
+	for (int i=0; i<n; i++) {foldsource[i] = cp.capsource[i]; foldsink[i] = cp.capsink[i];}
+
+	// n-links inside a part are bucketed, the others folded
+	edgestart.assign(numparts+1, 0);
+	for (size_t e=0; e<cp.edges.size(); e++) {
+		const CutEdge & edge = cp.edges[e];
+		int kp = part[edge.p], kq = part[edge.q];
+		if (kp >= 0 && kp == kq) {edgestart[kp+1]++; continue;}
+		if (kp >= 0) {if (onsource(edge.q, kp)) foldsource[edge.p] += edge.cap; else foldsink[edge.p] += edge.cap;}
+		if (kq >= 0) {if (onsource(edge.p, kq)) foldsource[edge.q] += edge.cap; else foldsink[edge.q] += edge.cap;}
+	}
+	for (int k=0; k<numparts; k++) edgestart[k+1] += edgestart[k];
+	edges.resize(edgestart[numparts]);
+	fill.assign(edgestart.begin(), edgestart.end()-1);
+	for (size_t e=0; e<cp.edges.size(); e++) {
+		int kp = part[cp.edges[e].p];
+		if (kp >= 0 && kp == part[cp.edges[e].q]) edges[fill[kp]++] = (int)e;
+	}
+}
+
+inline void PartitionedCut::build(int k, IBFSGraph & g, const int * extrasource) const
+{
+	const int * partnodes = getNodes(k);
+	const int numnodes = getNumNodes(k);
+	g.initSize(numnodes, getNumEdges(k));
+	for (int i=0; i<numnodes; i++) {
+		int n = partnodes[i];
+		// only the difference matters, it is clipped to the int capacities of IBFS
+		long long net = foldsource[n] - foldsink[n] + (extrasource ? extrasource[n] : 0);
+		if (net > INT_MAX) net = INT_MAX;
+		if (net < -INT_MAX) net = -INT_MAX;
+		g.addNode(i, net > 0 ? (int)net : 0, net < 0 ? (int)-net : 0);
+	}
+	for (int e=edgestart[k]; e<edgestart[k+1]; e++) {
+		const CutEdge & edge = problem->edges[edges[e]];
+		g.addEdge(local[edge.p], local[edge.q], edge.cap, edge.cap);
+	}
+}
+
+inline int findcomponents(const CutProblem & cp, std::vector<int> & component)
+{
+	const int n = cp.numnodes;
+	std::vector<int> parent(n), size(n, 1);
+	for (int i=0; i<n; i++) parent[i] = i;
+	for (size_t e=0; e<cp.edges.size(); e++) {
+		const CutEdge & edge = cp.edges[e];
+		if (edge.cap <= 0 || cp.isfixed(edge.p) || cp.isfixed(edge.q)) continue;
+		int a = edge.p, b = edge.q;
+		while (parent[a] != a) a = parent[a] = parent[parent[a]];
+		while (parent[b] != b) b = parent[b] = parent[parent[b]];
+		if (a == b) continue;
+		if (size[a] < size[b]) std::swap(a, b);
+		parent[b] = a;
+		size[a] += size[b];
+	}
+	// roots numbered in order of their first node
+	int numcomponents = 0;
+	component.assign(n, -1);
+	for (int i=0; i<n; i++) {
+		if (cp.isfixed(i)) continue;
+		int r = i;
+		while (parent[r] != r) r = parent[r];
+		if (component[r] < 0) component[r] = numcomponents++;
+		component[i] = component[r];
+	}
+	return numcomponents;
+}
+
+inline long long solvecomponents(const CutProblem & cp, std::vector<unsigned char> & label, int * numcomponents)
+{
+	const int n = cp.numnodes;
+	std::vector<int> component;
+	int numparts = findcomponents(cp, component);
+	if (numcomponents) *numcomponents = numparts;
+	label.resize(n);
+	for (int i=0; i<n; i++) if (component[i] < 0) label[i] = (cp.capsource[i] == INT_MAX) ? 1 : 0;
+	PartitionedCut parts;
+	parts.split(cp, component, numparts, [&](int q, int k){ return cp.capsource[q] == INT_MAX; });
+
+	#pragma omp parallel for schedule(dynamic)
+	for (int k=0; k<numparts; k++) {
+		const int * nodes = parts.getNodes(k);
+		IBFSGraph g(IBFSGraph::IB_INIT_FAST);
+		parts.build(k, g);
+		g.initGraph();
+		g.computeMaxFlow(true); // complete both trees, free nodes are then on the maximal source side
+		for (int i=0; i<parts.getNumNodes(k); i++) label[nodes[i]] = g.isNodeOnSrcSide(i, 1) ? 1 : 0;
+	}
+
+	// value of the merged cut, a min cut of the whole problem
+	long long cut = 0;
+	for (int i=0; i<n; i++) cut += label[i] ? cp.capsink[i] : cp.capsource[i];
+	for (size_t e=0; e<cp.edges.size(); e++)
+		if (label[cp.edges[e].p] != label[cp.edges[e].q]) cut += cp.edges[e].cap;
+	return cut;
+}
+
+inline void ReducedCut::reduce(const CutProblem & cp)
+{
+	problem = &cp;
+	const int n = cp.numnodes;
+	// incident n-links by counting sort
+	adjstart.assign(n+1, 0);
+	for (size_t e=0; e<cp.edges.size(); e++) {adjstart[cp.edges[e].p+1]++; adjstart[cp.edges[e].q+1]++;}
+	for (int i=0; i<n; i++) adjstart[i+1] += adjstart[i];
+	adj.resize(adjstart[n]);
+	std::vector<int> fill(adjstart.begin(), adjstart.end()-1);
+	std::vector<long long> incident(n, 0); // capacity of the n-links to free nodes
+	for (size_t e=0; e<cp.edges.size(); e++) {
+		const CutEdge & edge = cp.edges[e];
+		adj[fill[edge.p]++] = (int)e;
+		adj[fill[edge.q]++] = (int)e;
+		incident[edge.p] += edge.cap;
+		incident[edge.q] += edge.cap;
+	}
+
+	foldsource.resize(n);
+	foldsink.resize(n);
+	fixed.assign(n, -1);
+	queue.clear();
+	for (int i=0; i<n; i++) {
+		foldsource[i] = cp.capsource[i];
+		foldsink[i] = cp.capsink[i];
+		if (cp.isfixed(i)) {fixed[i] = (cp.capsource[i] == INT_MAX) ? 1 : 0; queue.push_back(i);}
+	}
+	numpersistent = 0;
+	for (int i=0; i<n; i++) {
+		if (fixed[i] >= 0) continue;
+		if (foldsource[i]-foldsink[i] >= incident[i]) fixed[i] = 1;
+		else if (foldsink[i]-foldsource[i] > incident[i]) fixed[i] = 0;
+		else continue;
+		numpersistent++;
+		queue.push_back(i);
+	}
+	// fold the n-links of fixed nodes into their free neighbors, which may become persistent
+	for (size_t head=0; head<queue.size(); head++) {
+		const int i = queue[head];
+		for (int a=adjstart[i]; a<adjstart[i+1]; a++) {
+			const CutEdge & edge = cp.edges[adj[a]];
+			const int j = (edge.p == i) ? edge.q : edge.p;
+			if (fixed[j] >= 0) continue;
+			if (fixed[i]) foldsource[j] += edge.cap; else foldsink[j] += edge.cap;
+			incident[j] -= edge.cap;
+			if (foldsource[j]-foldsink[j] >= incident[j]) fixed[j] = 1;
+			else if (foldsink[j]-foldsource[j] > incident[j]) fixed[j] = 0;
+			else continue;
+			numpersistent++;
+			queue.push_back(j);
+		}
+	}
+
+	// the residual, and the cut of everything else: t-links of fixed nodes, n-links between fixed nodes
+	// of both sides and what the nets of the residual t-links drop
+	nodes.clear();
+	local.assign(n, -1);
+	offset = 0;
+	for (int i=0; i<n; i++) {
+		if (fixed[i] < 0) {
+			local[i] = (int)nodes.size();
+			nodes.push_back(i);
+			offset += std::min(foldsource[i], foldsink[i]);
+		}
+		else offset += fixed[i] ? cp.capsink[i] : cp.capsource[i];
+	}
+	edges.clear();
+	for (size_t e=0; e<cp.edges.size(); e++) {
+		const CutEdge & edge = cp.edges[e];
+		if (fixed[edge.p] < 0 && fixed[edge.q] < 0) edges.push_back((int)e);
+		else if (fixed[edge.p] >= 0 && fixed[edge.q] >= 0 && fixed[edge.p] != fixed[edge.q]) offset += edge.cap;
+	}
+}
+
+template <class IBFSLike>
+void ReducedCut::build(IBFSLike & g) const
+{
+	g.initSize(getNumNodes(), getNumEdges());
+	for (int i=0; i<getNumNodes(); i++) {
+		long long v = net(i);
+		g.addNode(i, v > 0 ? (int)v : 0, v < 0 ? (int)-v : 0);
+	}
+	for (size_t e=0; e<edges.size(); e++) {
+		const CutEdge & edge = problem->edges[edges[e]];
+		g.addEdge(local[edge.p], local[edge.q], edge.cap, edge.cap);
+	}
+}
+
+template <class captype, class tcaptype, class flowtype>
+void ReducedCut::build(Graph<captype,tcaptype,flowtype> & g) const
+{
+	g.add_node(getNumNodes());
+	for (int i=0; i<getNumNodes(); i++) {
+		long long v = net(i);
+		g.add_tweights(i, (tcaptype)(v > 0 ? v : 0), (tcaptype)(v < 0 ? -v : 0));
+	}
+	for (size_t e=0; e<edges.size(); e++) {
+		const CutEdge & edge = problem->edges[edges[e]];
+		g.add_edge(local[edge.p], local[edge.q], (captype)edge.cap, (captype)edge.cap);
+	}
+}
+
+template <class OnSource>
+void ReducedCut::expand(OnSource onsource, std::vector<unsigned char> & label) const
+{
+	const int n = problem->numnodes;
+	label.resize(n);
+	for (int i=0; i<n; i++) label[i] = (fixed[i] < 0) ? (onsource(local[i]) ? 1 : 0) : fixed[i];
+}
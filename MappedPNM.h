@@ -0,0 +1,109 @@
+#pragma once
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Binary PNM file (P6 RGB or P5 gray, maxval 255) mapped into memory, for images that do not fit in RAM.
+// Pixels are row-major with getChannels() bytes each, row y starts at row(y). Pages are read on demand;
+// prefetchRows() and evictRows() advise the kernel about the rows of the tile being worked on.
+//
+//		MappedPNM image, mask;
+//		image.open("slide.ppm");                                    // read only
+//		mask.create("mask.pgm", image.getWidth(), image.getHeight(), 1);  // written through the mapping
+class MappedPNM
+{
+public:
+	MappedPNM() : m_fd(-1), m_map(NULL), m_mapsize(0), m_pixels(NULL), m_width(0), m_height(0), m_channels(0) {}
+	~MappedPNM() {close();}
+
+	// maps an existing P6 or P5 file, read only
+	bool open(const char * filename)
+	{
+		close();
+		m_fd = ::open(filename, O_RDONLY);
+		if (m_fd < 0) return false;
+		struct stat st;
+		if (fstat(m_fd, &st) != 0 || st.st_size < 2) {close(); return false;}
+		m_mapsize = st.st_size;
+		void * map = mmap(NULL, m_mapsize, PROT_READ, MAP_SHARED, m_fd, 0);
+		if (map == MAP_FAILED) {m_map = NULL; close(); return false;}
+		m_map = (unsigned char *)map;
+		// header: magic, width, height, maxval separated by whitespace or comments, then one whitespace byte
+		size_t pos = 2;
+		int fields[3];
+		if (m_map[0] != 'P' || (m_map[1] != '6' && m_map[1] != '5')) {close(); return false;}
+		for (int f=0; f<3; f++) {
+			while (pos < m_mapsize && (isspaceChar(m_map[pos]) || m_map[pos] == '#')) {
+				if (m_map[pos] == '#') {while (pos < m_mapsize && m_map[pos] != '\n') pos++;}
+				else pos++;
+			}
+			fields[f] = 0;
+			while (pos < m_mapsize && m_map[pos] >= '0' && m_map[pos] <= '9') fields[f] = fields[f]*10+(m_map[pos++]-'0');
+		}
+		pos++;
+		m_width = fields[0]; m_height = fields[1];
+		m_channels = (m_map[1] == '6') ? 3 : 1;
+		if (fields[2] != 255 || pos+getBytes() > m_mapsize) {close(); return false;}
+		m_pixels = m_map+pos;
+		return true;
+	}
+	// creates a zero filled file of the given size (P6 for 3 channels, P5 for 1) and maps it writable
+	bool create(const char * filename, int width, int height, int channels)
+	{
+		close();
+		char header[64];
+		int headersize = sprintf(header, "P%d\n%d %d\n255\n", channels == 3 ? 6 : 5, width, height);
+		m_width = width; m_height = height; m_channels = channels;
+		m_mapsize = headersize+getBytes();
+		m_fd = ::open(filename, O_RDWR|O_CREAT|O_TRUNC, 0644);
+		if (m_fd < 0 || ftruncate(m_fd, m_mapsize) != 0) {close(); return false;}
+		void * map = mmap(NULL, m_mapsize, PROT_READ|PROT_WRITE, MAP_SHARED, m_fd, 0);
+		if (map == MAP_FAILED) {m_map = NULL; close(); return false;}
+		m_map = (unsigned char *)map;
+		memcpy(m_map, header, headersize);
+		m_pixels = m_map+headersize;
+		return true;
+	}
+	void close()
+	{
+		if (m_map != NULL) munmap(m_map, m_mapsize);
+		if (m_fd >= 0) ::close(m_fd);
+		m_fd = -1; m_map = NULL; m_mapsize = 0; m_pixels = NULL;
+	}
+
+	bool isOpen() const {return m_pixels != NULL;}
+	int getWidth() const {return m_width;}
+	int getHeight() const {return m_height;}
+	int getChannels() const {return m_channels;}
+	size_t getBytes() const {return (size_t)m_width*m_height*m_channels;}
+	unsigned char * row(int y) const {return m_pixels+(size_t)y*m_width*m_channels;}
+
+	// advise the kernel that rows [y1,y2) are needed soon, or are not needed anymore
+	// (dropped pages of a writable file are kept in the page cache and written back)
+	void prefetchRows(int y1, int y2) const {adviseRows(y1, y2, MADV_WILLNEED);}
+	void evictRows(int y1, int y2) const {adviseRows(y1, y2, MADV_DONTNEED);}
+	void adviseSequential() const {if (m_map) madvise(m_map, m_mapsize, MADV_SEQUENTIAL);}
+	void adviseRandom() const {if (m_map) madvise(m_map, m_mapsize, MADV_NORMAL);}
+
+private:
+	int m_fd;
+	unsigned char * m_map;
+	size_t m_mapsize;
+	unsigned char * m_pixels;
+	int m_width, m_height, m_channels;
+
+	static bool isspaceChar(unsigned char c) {return c == ' ' || c == '\t' || c == '\n' || c == '\r';}
+	void adviseRows(int y1, int y2, int advice) const
+	{
+		if (m_map == NULL || y1 >= y2) return;
+		const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+		size_t first = (size_t)(row(y1)-m_map)/page*page, last = (size_t)(row(y2)-m_map);
+		madvise(m_map+first, last-first, advice);
+	}
+
+	MappedPNM(const MappedPNM&);
+	MappedPNM& operator=(const MappedPNM&);
+};
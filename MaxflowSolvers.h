@@ -0,0 +1,194 @@
+#pragma once
+#include <limits.h>
+#include <new>
+#include "maxflow/graph.h" // for BK algorithm
+#include "ibfs/ibfs.h"     // for IBFS algorithm
+#include "pushrelabel/pushrelabel.h" // for PUSHRELABEL algorithm
+#include "gridflow/gridflow.h" // for GRID algorithm
+#include "MemArena.h"
+#include "myutil.h"
+
+// which maxflow algorithm to use: Boykov-Kolmogorov, IBFS, the parallel push-relabel of PushRelabelGraph or
+// IBFS on the implicit grid of GridGraph, one solver policy below each. GRID is for memory: on the sample
+// its peak RSS is half that of IBFS at C=4, 0.45x at C=8 and 0.4x at C=16, it solves 1.1x slower at C=4,
+// 1.25x at C=8 and as fast at C=16, so IBFS stays the default.
+enum MAXFLOW {BK, IBFS, PUSHRELABEL, GRID};
+
+// Solver policies: OneCut builds and solves its graphs in templates on a policy, so the calls below are
+// resolved at compile time and the per-pixel and per-edge loops carry no branch on the algorithm. OneCut
+// picks the policy once per call from its MAXFLOW (see OneCut::dispatch()). A new engine is a new policy
+// with the same members, a MAXFLOW value and a case in dispatch().
+//
+//		Cap                 capacity type of the engine
+//		create / destroy    a graph for numnodes nodes and numedges undirected edges, from the arena if not NULL.
+//		                    The first img_w*img_h nodes are the pixels x+y*img_w of a grid with the given
+//		                    connectivity, only GridSolver makes use of it
+//		cap(w)              capacity of an energy term w, hard() of an infinite one
+//		addtlink            adds to the terminal links of a node
+//		addedge             adds an undirected edge
+//		addedges            adds lambda*edgeweight edges for a range of Edge-like records (p, q, edgeweight)
+//		solve               computes a maximum flow and returns it, in the units of cap()
+//		onsource            side of a node after solve() (free nodes on the source side),
+//		                    getsides/getsidespacked for the nodes [0,n) as OneCut::run(mask)/runpacked()
+
+struct BKSolver
+{
+	typedef GraphType Graph;
+	typedef double Cap;
+	static const MAXFLOW engine = BK;
+
+	static Graph * create(int numnodes, int numedges, int img_w, int img_h, int connectivity, MemArena * arena){
+		void * mem = (arena!=NULL) ? arena->alloc(sizeof(Graph)) : ::operator new(sizeof(Graph));
+		Graph * g = new (mem) Graph(numnodes, numedges, NULL, arena);
+		g->add_node(numnodes);
+		return g;
+	}
+	static void destroy(Graph * g, MemArena * arena){
+		if(arena!=NULL) g->~Graph();
+		else delete g;
+	}
+	static Cap cap(double w) {return w;}
+	static Cap hard() {return INFTY;}
+	static void addtlink(Graph & g, int i, Cap src, Cap sink) {g.add_tweights(i,src,sink);}
+	static void addedge(Graph & g, int p, int q, Cap c) {g.add_edge(p,q,c,c);}
+	template<class E> static void addedges(Graph & g, const E * edges, int numedges, double lambda){
+		for(int i=0;i<numedges;i++)
+		{
+			Cap c = lambda*edges[i].edgeweight;
+			g.add_edge(edges[i].p,edges[i].q,c,c);
+		}
+	}
+	static double solve(Graph & g) {return g.maxflow();}
+	static bool onsource(Graph & g, int i) {return g.what_segment(i)==Graph::SOURCE;}
+	static int getsides(Graph & g, unsigned char * mask, int n, unsigned char objvalue, unsigned char bkgvalue){
+		return g.get_segments(mask, 0, n, Graph::SOURCE, objvalue, bkgvalue);
+	}
+	static int getsidespacked(Graph & g, unsigned char * bits, int n){
+		return g.get_segments_packed(bits, 0, n, Graph::SOURCE);
+	}
+};
+
+// integer capacities scaled by FLOATTOINTSCALE, hard constraints INFTY clipped to int
+struct IBFSSolver
+{
+	typedef IBFSGraph Graph;
+	typedef int Cap;
+	static const MAXFLOW engine = IBFS;
+
+	static Graph * create(int numnodes, int numedges, int img_w, int img_h, int connectivity, MemArena * arena){
+		void * mem = (arena!=NULL) ? arena->alloc(sizeof(Graph)) : ::operator new(sizeof(Graph));
+		Graph * g = new (mem) Graph(Graph::IB_INIT_FAST, arena);
+		g->initSize(numnodes, numedges);
+		return g;
+	}
+	static void destroy(Graph * g, MemArena * arena){
+		if(arena!=NULL) g->~Graph();
+		else delete g;
+	}
+	static Cap cap(double w) {return (int)(w*FLOATTOINTSCALE);}
+	static Cap cap(float w) {return (int)(w*FLOATTOINTSCALE);} // scaled in float, as OneCut::sweep() does
+	static Cap hard() {return INT_MAX;}
+	static void addtlink(Graph & g, int i, Cap src, Cap sink) {g.addNode(i,src,sink);}
+	static void addedge(Graph & g, int p, int q, Cap c) {g.addEdge(p,q,c,c);}
+	template<class E> static void addedges(Graph & g, const E * edges, int numedges, double lambda){
+		for(int i=0;i<numedges;i++)
+		{
+			Cap c = cap(lambda*edges[i].edgeweight);
+			g.addEdge(edges[i].p,edges[i].q,c,c);
+		}
+	}
+	static double solve(Graph & g){
+		g.initGraph();
+		g.computeMaxFlow();
+		return g.getFlow();
+	}
+	// free nodes go to the foreground
+	static bool onsource(Graph & g, int i) {return g.isNodeOnSrcSide(i,1)!=0;}
+	static int getsides(Graph & g, unsigned char * mask, int n, unsigned char objvalue, unsigned char bkgvalue){
+		return g.getNodeSides(mask, 0, n, true, objvalue, bkgvalue);
+	}
+	static int getsidespacked(Graph & g, unsigned char * bits, int n){
+		return g.getNodeSidesPacked(bits, 0, n, true);
+	}
+};
+
+// capacities as IBFSSolver
+struct PushRelabelSolver
+{
+	typedef PushRelabelGraph Graph;
+	typedef int Cap;
+	static const MAXFLOW engine = PUSHRELABEL;
+
+	static Graph * create(int numnodes, int numedges, int img_w, int img_h, int connectivity, MemArena * arena){
+		void * mem = (arena!=NULL) ? arena->alloc(sizeof(Graph)) : ::operator new(sizeof(Graph));
+		Graph * g = new (mem) Graph(arena);
+		g->initSize(numnodes, numedges);
+		return g;
+	}
+	static void destroy(Graph * g, MemArena * arena){
+		if(arena!=NULL) g->~Graph();
+		else delete g;
+	}
+	static Cap cap(double w) {return (int)(w*FLOATTOINTSCALE);}
+	static Cap cap(float w) {return (int)(w*FLOATTOINTSCALE);} // scaled in float, as OneCut::sweep() does
+	static Cap hard() {return INT_MAX;}
+	static void addtlink(Graph & g, int i, Cap src, Cap sink) {g.addNode(i,src,sink);}
+	static void addedge(Graph & g, int p, int q, Cap c) {g.addEdge(p,q,c,c);}
+	template<class E> static void addedges(Graph & g, const E * edges, int numedges, double lambda){
+		for(int i=0;i<numedges;i++)
+		{
+			Cap c = cap(lambda*edges[i].edgeweight);
+			g.addEdge(edges[i].p,edges[i].q,c,c);
+		}
+	}
+	static double solve(Graph & g) {return (double)g.computeMaxFlow();}
+	static bool onsource(Graph & g, int i) {return g.isNodeOnSrcSide(i);}
+	static int getsides(Graph & g, unsigned char * mask, int n, unsigned char objvalue, unsigned char bkgvalue){
+		return g.getNodeSides(mask, 0, n, objvalue, bkgvalue);
+	}
+	static int getsidespacked(Graph & g, unsigned char * bits, int n){
+		return g.getNodeSidesPacked(bits, 0, n);
+	}
+};
+
+// capacities as IBFSSolver. The edges between grid neighbors go into the residual planes of GridGraph, the
+// others (the color separation arcs of OneCut) into its explicit adjacency.
+struct GridSolver
+{
+	typedef GridGraph Graph;
+	typedef int Cap;
+	static const MAXFLOW engine = GRID;
+
+	static Graph * create(int numnodes, int numedges, int img_w, int img_h, int connectivity, MemArena * arena){
+		void * mem = (arena!=NULL) ? arena->alloc(sizeof(Graph)) : ::operator new(sizeof(Graph));
+		Graph * g = new (mem) Graph(arena);
+		long long numgridedges = Graph::getNumGridEdges(img_w, img_h, connectivity);
+		g->initSize(img_w, img_h, connectivity, numnodes-img_w*img_h,
+			numedges>numgridedges ? (int)(numedges-numgridedges) : 0);
+		return g;
+	}
+	static void destroy(Graph * g, MemArena * arena){
+		if(arena!=NULL) g->~Graph();
+		else delete g;
+	}
+	static Cap cap(double w) {return (int)(w*FLOATTOINTSCALE);}
+	static Cap cap(float w) {return (int)(w*FLOATTOINTSCALE);} // scaled in float, as OneCut::sweep() does
+	static Cap hard() {return INT_MAX;}
+	static void addtlink(Graph & g, int i, Cap src, Cap sink) {g.addNode(i,src,sink);}
+	static void addedge(Graph & g, int p, int q, Cap c) {g.addEdge(p,q,c,c);}
+	template<class E> static void addedges(Graph & g, const E * edges, int numedges, double lambda){
+		for(int i=0;i<numedges;i++)
+		{
+			Cap c = cap(lambda*edges[i].edgeweight);
+			g.addEdge(edges[i].p,edges[i].q,c,c);
+		}
+	}
+	static double solve(Graph & g) {return (double)g.computeMaxFlow();}
+	static bool onsource(Graph & g, int i) {return g.isNodeOnSrcSide(i);}
+	static int getsides(Graph & g, unsigned char * mask, int n, unsigned char objvalue, unsigned char bkgvalue){
+		return g.getNodeSides(mask, 0, n, objvalue, bkgvalue);
+	}
+	static int getsidespacked(Graph & g, unsigned char * bits, int n){
+		return g.getNodeSidesPacked(bits, 0, n);
+	}
+};
@@ -0,0 +1,159 @@
+#pragma once
+#include <stdlib.h>
+#include <vector>
+#include <new>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Bump allocator owning all transient memory of one segmentation run.
+// Allocations are never freed individually, reset() forgets all of them at once.
+// When a run needed more than one chunk, reset() replaces the chunks by a single
+// chunk of the total size, so that a worker repeating similar runs stops allocating
+// from the heap after the first run and its memory usage stays flat.
+//
+//		MemArena arena;           // one per worker thread
+//		for (each request) {
+//			arena.reset();        // everything drawn from the arena by the previous request is gone
+//			... IBFSGraph g(IBFSGraph::IB_INIT_FAST, &arena); ...
+//		}
+//
+// With a backing file, chunks are shared mappings of that file instead of heap memory, so graphs larger
+// than the RAM budget are paged to the file by the kernel instead of failing. prefetch() and evict()
+// advise the kernel to read in or drop the pages in use around the solve of each tile.
+//
+// Running out of memory, or failing to open or grow the backing file, throws std::bad_alloc: the arena
+// lives inside libraries and servers, so it neither prints nor exits.
+class MemArena
+{
+public:
+	MemArena(size_t initialSize = 0, const char * backingFile = NULL)
+		:current(0), offset(0), systemAllocs(0), fd(-1), fileSize(0)
+	{
+		if (backingFile != NULL) {
+			fd = open(backingFile, O_RDWR|O_CREAT|O_TRUNC, 0600);
+			if (fd < 0) throw std::bad_alloc();
+		}
+		if (initialSize > 0) addChunk(initialSize);
+	}
+	~MemArena()
+	{
+		for (size_t i=0; i<chunks.size(); i++) freeChunk(chunks[i]);
+		if (fd >= 0) close(fd);
+	}
+
+	// returns uninitialized memory aligned on "alignment" bytes (a power of 2)
+	void* alloc(size_t size, size_t alignment = 64)
+	{
+		while (current < chunks.size())
+		{
+			size_t base = (size_t)chunks[current].mem;
+			size_t start = ((base + offset + alignment-1) & ~(alignment-1)) - base;
+			if (start + size <= chunks[current].size) {
+				offset = start + size;
+				chunks[current].used = offset;
+				return chunks[current].mem + start;
+			}
+			current++;
+			offset = 0;
+		}
+		size_t chunkSize = (chunks.empty() ? 0 : 2*chunks.back().size);
+		if (chunkSize < size + alignment) chunkSize = size + alignment;
+		addChunk(chunkSize);
+		return alloc(size, alignment);
+	}
+	template <class T> T* alloc(size_t num) {
+		return (T*)alloc(num*sizeof(T));
+	}
+
+	// forgets all allocations, the memory is kept for the next run
+	void reset()
+	{
+		if (chunks.size() > 1)
+		{
+			size_t total = 0;
+			for (size_t i=0; i<chunks.size(); i++) {
+				total += chunks[i].size;
+				freeChunk(chunks[i]);
+			}
+			chunks.clear();
+			if (fd >= 0) fileSize = 0; // the single chunk starts the file again
+			addChunk(total);
+		}
+		for (size_t i=0; i<chunks.size(); i++) chunks[i].used = 0;
+		current = 0;
+		offset = 0;
+	}
+
+	size_t getCapacity() const {
+		size_t total = 0;
+		for (size_t i=0; i<chunks.size(); i++) total += chunks[i].size;
+		return total;
+	}
+	size_t getUsed() const {
+		size_t total = 0;
+		for (size_t i=0; i<chunks.size(); i++) total += chunks[i].used;
+		return total;
+	}
+	// number of chunks taken from the heap so far, constant in steady state
+	int getSystemAllocs() const {
+		return systemAllocs;
+	}
+	bool isFileBacked() const {return fd >= 0;}
+
+	// advise the kernel to read in (prefetch) or to drop (evict) the pages in use,
+	// evicted pages of a backing file are written back and read again on access
+	void prefetch() {advise(MADV_WILLNEED);}
+	void evict() {advise(MADV_DONTNEED);}
+
+private:
+	struct Chunk
+	{
+		char	*mem;
+		size_t	size;
+		size_t	used;
+	};
+	std::vector<Chunk> chunks;
+	size_t current; // chunk allocations are currently taken from
+	size_t offset; // first free byte in the current chunk
+	int systemAllocs;
+	int fd; // backing file, -1 for heap chunks
+	size_t fileSize; // chunks of the backing file are mapped at consecutive page aligned offsets
+
+	void addChunk(size_t size)
+	{
+		Chunk c;
+		if (fd >= 0) {
+			const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+			size = (size+page-1)/page*page;
+			void * mem = MAP_FAILED;
+			if (ftruncate(fd, fileSize+size) == 0)
+				mem = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, fileSize);
+			if (mem == MAP_FAILED) throw std::bad_alloc();
+			c.mem = (char*)mem;
+			fileSize += size;
+		} else {
+			c.mem = (char*)malloc(size);
+			if (c.mem == NULL) throw std::bad_alloc();
+		}
+		c.size = size;
+		c.used = 0;
+		chunks.push_back(c);
+		systemAllocs++;
+	}
+	void freeChunk(Chunk & c)
+	{
+		if (fd >= 0) munmap(c.mem, c.size);
+		else free(c.mem);
+	}
+	void advise(int advice)
+	{
+		if (fd < 0) return; // heap chunks stay resident
+		const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+		for (size_t i=0; i<chunks.size(); i++)
+			if (chunks[i].used > 0) madvise(chunks[i].mem, (chunks[i].used+page-1)/page*page, advice);
+	}
+
+	MemArena(const MemArena&);
+	MemArena& operator=(const MemArena&);
+};
@@ -3,11 +3,18 @@
 #include <vector>
 #include <time.h>
 #include <string>
+#include <algorithm>
+#include <utility>
+#include <queue>
+#include <stdexcept>
 
 #include "ezi/Image2D.h"
 #include "ezi/Table2D.h"
-#include "maxflow/graph.h" // for BK algorithm
-#include "ibfs/ibfs.h"     // for IBFS algorithm
+#include "MaxflowSolvers.h" // BK, IBFS, PUSHRELABEL and GRID as solver policies
+#include "MemArena.h"
+#include "BinaryMask.h"
+#include "CutProblem.h"
+#include "SuperPixels.h"
 #include "myutil.h"
 
 template<class T>
@@ -19,283 +26,1169 @@ struct Edge
 	int q;
 	T edgeweight;
 };
-// which maxflow algorithm to use, either Boykov-Kolmogorov or IBFS
-enum MAXFLOW {BK, IBFS};
-int getl1penalty(Table2D<int> & colorlabel,Table2D<int> & box);
+// neighborhood of the grid: connectivity C uses the first C/2 shifts, each pair of neighbors once
+static const int gridshiftx[8] = {1,0,1,1,2,2,1,-1};
+static const int gridshifty[8] = {0,1,1,-1,-1,1,2,2};
+// range of the shifts for connectivity C, a pixel with margins -minx..maxx and -miny..maxy
+// to the image border has all of its neighbors inside the image
+template<int C>
+struct GridShifts
+{
+	static const int count = C/2;
+	static const int minx = (C==16) ? -1 : 0;
+	static const int maxx = (C==16) ? 2 : 1;
+	static const int miny = (C==4) ? 0 : -1;
+	static const int maxy = (C==16) ? 2 : 1;
+};
+
+// calls f(p,q,i) for every pixel p and neighbor q = p+shift i inside a w x h image, in node order of p
+// and then in shift order. The interior runs without bounds checks and with the shift loop unrolled,
+// only the border strip tests each neighbor.
+template<int C, class F>
+inline void forgridneighbors(int w, int h, F f)
+{
+	typedef GridShifts<C> S;
+	for(int y=0;y<h;y++)
+	{
+		bool rowin = (y+S::miny>=0)&&(y+S::maxy<h);
+		int xa = rowin ? std::min(-S::minx,w) : w; // interior columns [xa,xb)
+		int xb = rowin ? std::max(w-S::maxx,xa) : w;
+		for(int x=0;x<w;x++)
+		{
+			Point p(x,y);
+			if(x==xa) // interior of the row
+			{
+				for(;x<xb;x++)
+				{
+					p.x = x;
+					#pragma GCC unroll 8
+					for(int i=0;i<S::count;i++)
+						f(p,Point(x+gridshiftx[i],y+gridshifty[i]),i);
+				}
+				if(x==w) break;
+				p.x = x;
+			}
+			for(int i=0;i<S::count;i++)
+			{
+				Point q(x+gridshiftx[i],y+gridshifty[i]);
+				if((q.x>=0)&&(q.x<w)&&(q.y>=0)&&(q.y<h))
+					f(p,q,i);
+			}
+		}
+	}
+}
+
+// how colors are quantized into the bins of the color separation term: uniform cubes of colorbinsize
+// per channel, or a median cut palette of at most numbins bins with balanced occupancy
+enum BINNING {UNIFORMBINS, MEDIANCUT};
+
+// statistics of the bounding box, gathered in one pass over box and color bins
+struct BoxStats
+{
+	BoxStats():boxsize(0),l1overlap(0){}
+	int boxsize; // number of pixels inside the box
+	vector<int> obj_hist; // color histogram inside the box
+	vector<int> bkg_hist; // color histogram outside the box
+	int l1overlap; // L1 overlap of the two histograms
+	PointPair rect; // bounding rectangle of the box interior (empty if rect.p1.x > rect.p2.x)
+};
+
+// one setting of a parameter sweep, see OneCut::sweep()
+struct SweepPoint
+{
+	SweepPoint(double weight_potts_ = 9.0, double beta_prime_ = 0.9, int connectivity_ = 0)
+		:weight_potts(weight_potts_),beta_prime(beta_prime_),connectivity(connectivity_){}
+	double weight_potts;
+	double beta_prime; // weight of the L1 color separation term relative to boxsize/l1overlap
+	int connectivity; // 4, 8 or 16, 0 keeps the current grid connectivity
+};
+
+struct SweepResult
+{
+	SweepPoint point;
+	double flow;
+	int numobj; // number of OBJ pixels
+	BitMask mask;
+};
+
+// result of one rectangle of OneCut::runboxes()
+struct BoxResult
+{
+	PointPair rect; // the rectangle clipped to the image (empty if rect.p1.x > rect.p2.x)
+	double flow;
+	int numobj; // number of OBJ pixels
+	BitMask mask; // of the rectangle, pixel (x,y) is mask.get(x-rect.p1.x,y-rect.p1.y)
+};
 
 class OneCut{
 public:
 	OneCut();
-	OneCut(Table2D<RGB> img_, double colorbinsize_, int GridConnectivity_ = 8, MAXFLOW maxflowoption = IBFS);
+	// the image is only read during construction, OneCut keeps no copy of it,
+	// a Table2D or a view of a sub-rectangle (see cropView) can be passed
+	// numbins is only used by MEDIANCUT, colorbinsize only by UNIFORMBINS
+	OneCut(const Table2DView<RGB> & img, double colorbinsize_, int GridConnectivity_ = 8, MAXFLOW maxflowoption = IBFS,
+		BINNING binningoption_ = UNIFORMBINS, int numbins_ = 1024);
 	~OneCut();
+	// (re)initialize for a new image, buffers of the previous image are reused
+	void setimage(const Table2DView<RGB> & img, double colorbinsize_, int GridConnectivity_ = 8, MAXFLOW maxflowoption = IBFS,
+		BINNING binningoption_ = UNIFORMBINS, int numbins_ = 1024);
+	// draw the graphs from a per-worker arena instead of the heap,
+	// the caller resets the arena between requests (the graphs of the previous run are released first)
+	void setarena(MemArena * arena_) {releasegraphs(); arena = arena_;}
 	// add smoothness term to the graph
 	// weight_potts is the weight of smoothness or Potts term
 	void addsmoothnessterm(double weight_potts);
 	// add color separation term to the graph
 	void addcolorseparation(const Table2D<int> &colorlabel,float weight_colorseparation);
+	// set the bounding box (255 outside, 0 inside) and cache its statistics,
+	// pass an rvalue to hand the box over without copying it
+	const BoxStats & setbox(Table2D<int> box_);
+	const BoxStats & setbox(const Table2DView<int> & box_);
+	const BoxStats & getboxstats() const {return boxstats;}
+	// hard constraints from user scribbles: OBJ pixels are fixed to foreground and BKG pixels
+	// to background, NONE pixels are free (an empty table removes all seeds)
+	void setseeds(Table2D<Label> seeds_) {seeds = std::move(seeds_);}
 	void constructbkgraph(Table2D<int> box, float weight_potts);
+	void constructbkgraph(const Table2DView<int> & box, float weight_potts) {constructbkgraph(Table2D<int>(box),weight_potts);}
+	// construct the graph for the box given to the last setbox(). Throws std::length_error if the arcs
+	// do not fit the int arc indices of the solvers (2*(n-links+pixels) < INT_MAX, about 119M pixels at
+	// 16-connectivity), the flow itself is counted in long long (double with BK)
+	void constructbkgraph(float weight_potts, float beta_prime = 0.9);
+	// solves for every setting in points with the box given to the last setbox(). With IBFS the graph is
+	// built once per connectivity, later settings only change capacities through the incremental interface
+	// and reuse the flow of the previous solve (BK rebuilds for each setting). img is only read when the
+	// connectivity changes. Points with the same connectivity should be adjacent, each change rebuilds.
+	void sweep(const Table2DView<RGB> & img, const vector<SweepPoint> & points, vector<SweepResult> & results);
+	// the graph constructbkgraph() builds for IBFS as an integer cut problem, nodes x+y*img_w and the color bins,
+	// ballooning is the foreground t-link of free pixels inside the box (1 in constructbkgraph)
+	void buildcutproblem(CutProblem & cp, float weight_potts, float beta_prime = 0.9, float ballooning = 1);
+	// solves for all ballooning weights (ascending) at once by divide and conquer over the weights: the
+	// solutions are nested, so every solve only involves the pixels still undecided between two weights and
+	// all decided pixels are folded into t-links (see PartitionedCut). firstindex[x][y] is the index of the
+	// first weight at which the pixel is OBJ, weights.size() if it never is, i.e. the segmentation for
+	// weights[k] is firstindex<=k. Solutions are the maximal foreground min cuts (IBFS run to completion).
+	// Every part gets a new graph, no flow is carried over: raising the ballooning of a solved part with
+	// incNode() for its upper half was no faster, as the graph keeps all the nodes already decided OBJ.
+	// Throws std::invalid_argument if weights are not ascending.
+	void parametricballooning(const vector<double> & weights, Table2D<int> & firstindex, float weight_potts, float beta_prime = 0.9);
+	// solves the graph of constructbkgraph() for the box of the last setbox() and the seeds after a persistency
+	// reduction (see ReducedCut), with the maxflow algorithm of setimage() (IBFS for GRID, the reduced graph is
+	// no grid anymore). getflow() is the flow of the whole
+	// graph, getreduction() tells how many nodes and n-links were eliminated.
+	void runreduced(Table2D<Label> & segmentation, float weight_potts, float beta_prime = 0.9);
+	const ReducedCut & getreduction() const {return reduction;}
+	// solves the graph of constructbkgraph() for the box of the last setbox() and the seeds as its connected
+	// components of free pixels and bins, each its own IBFS graph and in parallel (see solvecomponents()).
+	// getflow() is the flow of the whole graph. Returns the number of components.
+	int runcomponents(Table2D<Label> & segmentation, float weight_potts, float beta_prime = 0.9);
+	// segments every rectangle of rects as its own box, on the edges and color bins of setimage(). Pixels
+	// outside a box are hard BKG, so the graph of a box only has its pixels and bins: the n-links leaving
+	// the box and the color separation arcs of the pixels outside become sink t-links. Same energy and
+	// flow as constructbkgraph() with the box, at a cost of the box area. Boxes are solved in parallel
+	// (IBFS always, from the heap), the results are the maximal foreground min cuts. Seeds are not used.
+	void runboxes(const vector<PointPair> & rects, vector<BoxResult> & results, float weight_potts, float beta_prime = 0.9);
+	// superpixel mode: the energy of constructbkgraph() restricted to labelings where the free pixels of a
+	// superpixel share one label. Call after setimage() for the same image.
+	void setsuperpixels(const SuperPixels & sp);
+	// the superpixel graph (always IBFS) for the box of the last setbox(): one node per superpixel stands for its
+	// free pixels, with their ballooning as t-link. n-links sum the capacities of the pixel pairs across two
+	// superpixels, color separation arcs to a bin those of the free pixels in that bin. Pixels with a hard
+	// constraint keep their label, their n-links and color separation arcs are folded into t-links.
+	void constructsuperpixelgraph(float weight_potts, float beta_prime = 0.9);
+	// solves the superpixel graph into a pixel labeling, getflow() is its energy (as the flow of constructbkgraph(),
+	// up to n-links between hard pixels). With refineband > 0 the
+	// free pixels within refineband of the object boundary are solved again on the pixel graph, with all other
+	// pixels fixed to their superpixel label
+	void runsuperpixels(Table2D<Label> & segmentation, int refineband = 0);
 	Table2D<Label> run();
+	// as above, but writes into an existing table (reusing its container)
+	void run(Table2D<Label> & segmentation);
+	// as above, but streams the labeling straight from the solver into mask in node order (pixel x+y*img_w),
+	// objvalue for OBJ and bkgvalue for BKG pixels, returns the number of OBJ pixels
+	int run(unsigned char * mask, unsigned char objvalue = 1, unsigned char bkgvalue = 0);
+	// as above, one bit per pixel (set for OBJ): pixel i is bit i&7 of bits[i>>3], bits holds (img_w*img_h+7)/8 bytes
+	int runpacked(unsigned char * bits);
+	// as above, into a BitMask (1/32 of the memory of Table2D<Label>) or straight into run lengths
+	int run(BitMask & mask);
+	int run(RLEMask & mask);
+	// value of the cut found by the last run (IBFS, PUSHRELABEL and GRID flows are scaled by FLOATTOINTSCALE)
+	double getflow() const {return flow;}
+	// number of non-empty color bins, i.e. of auxiliary nodes
+	int getnumcolorbin() const {return numcolorbin;}
 
 	void print();
-	void computeedges();
-	void computebinning();
+	// n-links of the grid with contrast weights, dispatches once to computeedges<GridConnectivity>
+	void computeedges(const Table2DView<RGB> & img);
+	void computebinning(const Table2DView<RGB> & img);
+	void computebinningmediancut(const Table2DView<RGB> & img);
 private:
-	Table2D<RGB> img;
 	int img_w;
 	int img_h;
 	int GridConnectivity; // can be 4 or 8 or 16
 	int numcolorbin;
 	int colorbinsize;
+	BINNING binningoption;
+	int numbins; // upper bound of numcolorbin for MEDIANCUT
 	Table2D<int> colorbinning;
+	vector<int> binhist; // number of pixels of the image in each color bin
+	CutProblem reducedproblem; // of the last runreduced(), reduction refers to it
+	ReducedCut reduction;
+	Table2D<int> box;
+	BoxStats boxstats;
+	Table2D<Label> seeds;
 
 	vector<Edge<double> > edges;
 	MAXFLOW maxflowoption;
+	double flow;
 	GraphType * bkgraph;
 	IBFSGraph * ibfsgraph;
+	PushRelabelGraph * prgraph;
+	GridGraph * gridgraph;
+	MemArena * arena;
+
+	// scratch space of computebinning, kept to avoid reallocation on the next image
+	vector<int> binhashkey;
+	vector<int> binhashval;
+	vector<int> binoccupied;
+	vector<int> cellcount; // scratch space of computebinningmediancut
+	vector<int> cellbin;
+	vector<int> cells;
+	BitMask rlescratch; // packed labels run(RLEMask&) encodes from
+
+	// superpixel graph, see setsuperpixels()
+	int numsp;
+	vector<int> spofnode; // superpixel of every pixel, in node order
+	vector<int> spstart, sppixels; // pixels of superpixel k are sppixels[spstart[k]..spstart[k+1])
+	vector<int> spadjstart, spadj; // neighbors b > a of superpixel a are spadj[spadjstart[a]..spadjstart[a+1])
+	float spweight_potts, spbeta_prime; // of the last constructsuperpixelgraph()
+	double spflowoffset; // part of the energy that does not depend on the cut
+	vector<Label> sphardnode, splabeling;
+	vector<long long> sppaircap, spfoldsource, spfoldsink;
+	vector<int> spbincount, spband;
+
+	template<int C> void computeedges(const Table2DView<RGB> & img);
+	// calls f(BKSolver()), f(IBFSSolver()), f(PushRelabelSolver()) or f(GridSolver()) for maxflowoption, the only branch on
+	// the algorithm: everything below it is compiled per solver policy (see MaxflowSolvers.h)
+	template<class F> void dispatch(F f);
+	// the graph of solver policy S
+	GraphType *& graph(BKSolver) {return bkgraph;}
+	IBFSGraph *& graph(IBFSSolver) {return ibfsgraph;}
+	PushRelabelGraph *& graph(PushRelabelSolver) {return prgraph;}
+	GridGraph *& graph(GridSolver) {return gridgraph;}
+	template<class S> void constructgraph(S solver, float weight_potts, float beta_prime);
+	template<class S> void addsmoothnessterm(S solver, double lambda);
+	template<class S> void addcolorseparation(S solver, const Table2D<int> &colorlabel, float separation_w);
+	void releasegraphs();
+	void maxflow(); // computes the cut of the constructed graph
+	void refinesuperpixels(Table2D<Label> & segmentation, int refineband);
+	float colorseparationweight(float beta_prime) const;
+	// hard constraint of a pixel: BKG outside the box, the seed label inside, NONE if free
+	Label hardlabel(int x, int y) const;
 };
 
-OneCut::OneCut():bkgraph(NULL),ibfsgraph(NULL)
+inline OneCut::OneCut():flow(0),bkgraph(NULL),ibfsgraph(NULL),prgraph(NULL),gridgraph(NULL),arena(NULL),numsp(0)
+{
+}
+
+inline OneCut::OneCut(const Table2DView<RGB> & img, double colorbinsize_, int GridConnectivity_, MAXFLOW maxflowoption_,
+	BINNING binningoption_, int numbins_)
+	:flow(0), bkgraph(NULL), ibfsgraph(NULL), prgraph(NULL), gridgraph(NULL), arena(NULL), numsp(0)
 {
+	setimage(img, colorbinsize_, GridConnectivity_, maxflowoption_, binningoption_, numbins_);
 }
 
-OneCut::OneCut(Table2D<RGB> img_, double colorbinsize_, int GridConnectivity_, MAXFLOW maxflowoption_)
-	:bkgraph(NULL), ibfsgraph(NULL), maxflowoption(maxflowoption_)
+inline OneCut::~OneCut(){
+	releasegraphs();
+}
+
+inline void OneCut::setimage(const Table2DView<RGB> & img, double colorbinsize_, int GridConnectivity_, MAXFLOW maxflowoption_,
+	BINNING binningoption_, int numbins_)
 {
 	Assert((GridConnectivity_==4)||(GridConnectivity_==8)||(GridConnectivity_==16), "grid connectivity can only be 4!");
-	img = Table2D<RGB>(img_);
+	releasegraphs();
+	maxflowoption = maxflowoption_;
 	img_w = img.getWidth();
 	img_h = img.getHeight();
 
 	GridConnectivity = GridConnectivity_;
-	computeedges();
+	computeedges(img);
 
 	colorbinsize = colorbinsize_;
-	computebinning();
-	numcolorbin = this->colorbinning.getMax()+1;
-}
-
-OneCut::~OneCut(){
-	if(bkgraph !=NULL) 
-		delete bkgraph;
-	if(ibfsgraph !=NULL) 
-		delete ibfsgraph;
+	binningoption = binningoption_;
+	numbins = numbins_;
+	if(binningoption==MEDIANCUT)
+		computebinningmediancut(img);
+	else
+		computebinning(img);
+	binhist.assign(numcolorbin,0);
+	for(int x=0;x<img_w;x++)
+	{
+		int * bin_col = colorbinning[x];
+		for(int y=0;y<img_h;y++)
+			binhist[bin_col[y]]++;
+	}
 }
 
-void OneCut::constructbkgraph(Table2D<int> box, float weight_potts){
-	// reset graph
-	if(bkgraph!=NULL){
-		delete bkgraph;
+inline void OneCut::releasegraphs(){
+	// graphs placed in the arena are destroyed but their memory stays until the arena is reset
+	if(bkgraph !=NULL){
+		BKSolver::destroy(bkgraph, arena);
 		bkgraph = NULL;
 	}
-	if(ibfsgraph!=NULL){
-		delete ibfsgraph;
+	if(ibfsgraph !=NULL){
+		IBFSSolver::destroy(ibfsgraph, arena);
 		ibfsgraph = NULL;
 	}
-	// construct graph
-	if(maxflowoption == BK){
-		bkgraph = new GraphType(/*estimated # of nodes*/ img_w*img_h+numcolorbin, 
-			/*estimated # of edges*/ 5*img_w*img_h); 
-		bkgraph->add_node(img_w*img_h+numcolorbin);    // adding nodes
-	}else if(maxflowoption == IBFS){
-		ibfsgraph = new IBFSGraph(IBFSGraph::IB_INIT_FAST);
-		ibfsgraph->initSize(img_w*img_h+numcolorbin,6*img_w*img_h);
+	if(prgraph !=NULL){
+		PushRelabelSolver::destroy(prgraph, arena);
+		prgraph = NULL;
 	}
+	if(gridgraph !=NULL){
+		GridSolver::destroy(gridgraph, arena);
+		gridgraph = NULL;
+	}
+}
 
-	if(maxflowoption==BK){
-		for(int x=0;x<img_w;x++)  
-		{
-			for(int y=0;y<img_h;y++)
-				if(box[x][y]==255)
-					bkgraph->add_tweights(x+y*img_w,0,INFTY);// Hard constraint outside the bounding box
-				else
-					bkgraph->add_tweights(x+y*img_w,1,0); // Linear foreground ballooning inside the box
-		}
-	}else if(maxflowoption==IBFS){
-		for(int x=0;x<img_w;x++)  
+template<class F> inline void OneCut::dispatch(F f){
+	switch(maxflowoption){
+		case BK: f(BKSolver()); break;
+		case IBFS: f(IBFSSolver()); break;
+		case PUSHRELABEL: f(PushRelabelSolver()); break;
+		case GRID: f(GridSolver()); break;
+	}
+}
+
+inline void OneCut::constructbkgraph(Table2D<int> box_, float weight_potts){
+	setbox(std::move(box_));
+	constructbkgraph(weight_potts);
+}
+
+inline const BoxStats & OneCut::setbox(const Table2DView<int> & box_){
+	box.resize(box_.getWidth(),box_.getHeight()); // copy into the cached box, reusing its container
+	for(int x=0;x<box.getWidth();x++)
+	{
+		int * box_col = box[x];
+		int * src_col = box_[x];
+		for(int y=0;y<box.getHeight();y++)
+			box_col[y] = src_col[y];
+	}
+	return setbox(std::move(box));
+}
+
+inline const BoxStats & OneCut::setbox(Table2D<int> box_){
+	box = std::move(box_);
+	boxstats.boxsize = 0;
+	boxstats.obj_hist.assign(numcolorbin,0);
+	boxstats.bkg_hist.assign(numcolorbin,0);
+	boxstats.rect = PointPair(img_w,img_h,-1,-1);
+	for(int x=0;x<img_w;x++)
+	{
+		int * box_col = box[x];
+		int * bin_col = colorbinning[x];
+		for(int y=0;y<img_h;y++)
 		{
-			for(int y=0;y<img_h;y++)
-				if(box[x][y]==255)
-					ibfsgraph->addNode(x+y*img_w,0,INFTY);// Hard constraint outside the bounding box
-				else
-					ibfsgraph->addNode(x+y*img_w,1*FLOATTOINTSCALE,0); // Linear foreground ballooning inside the box
+			if(box_col[y]==255)
+				boxstats.bkg_hist[bin_col[y]]++;
+			else
+			{
+				boxstats.obj_hist[bin_col[y]]++;
+				boxstats.boxsize++;
+				boxstats.rect.p1.x = min(boxstats.rect.p1.x,x);
+				boxstats.rect.p1.y = min(boxstats.rect.p1.y,y);
+				boxstats.rect.p2.x = max(boxstats.rect.p2.x,x);
+				boxstats.rect.p2.y = max(boxstats.rect.p2.y,y);
+			}
 		}
 	}
+	boxstats.l1overlap = 0;
+	for(int i=0;i<numcolorbin;i++)
+		boxstats.l1overlap += min(boxstats.obj_hist[i],boxstats.bkg_hist[i]);
+	return boxstats;
+}
 
+inline float OneCut::colorseparationweight(float beta_prime) const{
+	float l1penalty = max(boxstats.l1overlap,1); // a box without overlap gets the weight of an overlap of one pixel
+	int boxsize = boxstats.boxsize;
+	return (float)boxsize/l1penalty*beta_prime; // weight of L1 color separation term
+}
 
-	// weight of Potts term
-	addsmoothnessterm(weight_potts);
+inline void OneCut::constructbkgraph(float weight_potts, float beta_prime){
+	dispatch([&](auto solver){ constructgraph(solver, weight_potts, beta_prime); });
+}
 
-	float beta_prime = 0.9; // for L1 color separation term
-	float l1penalty = getl1penalty(colorbinning,box);
+template<class S> inline void OneCut::constructgraph(S solver, float weight_potts, float beta_prime){
+	// reset graph
+	releasegraphs();
+	// construct graph: n-links and one color separation arc per pixel
+	if((long long)edges.size()+(long long)img_w*img_h >= INT_MAX/2)
+		throw std::length_error("image too large for the int arc indices of the maxflow");
+	typename S::Graph * g = S::create(img_w*img_h+numcolorbin, edges.size()+img_w*img_h, img_w, img_h, GridConnectivity, arena);
+	graph(solver) = g;
 
-	int boxsize = countintable(box,0);
-	float weight_colorseparation = (float)boxsize/l1penalty*beta_prime; // weight of L1 color separation term
+	// only the bounding rectangle of the box needs to be read,
+	// everything outside of it has the hard background constraint
+	const PointPair & rect = boxstats.rect;
+	bool hasseeds = !seeds.isEmpty();
+	Assert(!hasseeds||((seeds.getWidth()==img_w)&&(seeds.getHeight()==img_h)),"seeds must match the image size");
+	const typename S::Cap hard = S::hard(), ballooning = S::cap(1.0);
+	for(int x=0;x<img_w;x++)  
+	{
+		bool colinrect = (x>=rect.p1.x)&&(x<=rect.p2.x);
+		int * box_col = box[x];
+		for(int y=0;y<img_h;y++)
+			if(!colinrect||(y<rect.p1.y)||(y>rect.p2.y)||(box_col[y]==255))
+				S::addtlink(*g,x+y*img_w,0,hard);// Hard constraint outside the bounding box
+			else if(hasseeds&&(seeds[x][y]!=NONE))
+				S::addtlink(*g,x+y*img_w,(seeds[x][y]==OBJ)?hard:0,(seeds[x][y]==BKG)?hard:0); // Hard constraint from scribbles
+			else
+				S::addtlink(*g,x+y*img_w,ballooning,0); // Linear foreground ballooning inside the box
+	}
+
+
+	// weight of Potts term
+	addsmoothnessterm(solver, weight_potts);
+
+	float weight_colorseparation = colorseparationweight(beta_prime);
 	//outv(weight_colorseparation);
 
-	addcolorseparation(colorbinning, weight_colorseparation);
+	addcolorseparation(solver, colorbinning, weight_colorseparation);
 
 }
 
-Table2D<Label> OneCut::run(){
-	Table2D<Label> segmentation(img_w,img_h,NONE);
-	if(maxflowoption==BK){
-		float flow = bkgraph->maxflow();
-		outv(flow);
-		getgraphlabeling(bkgraph, segmentation);
-	}else if(maxflowoption==IBFS){
-		ibfsgraph->initGraph();
-		ibfsgraph->computeMaxFlow();
-		outv(ibfsgraph->getFlow());
-		getgraphlabelingIBFS(ibfsgraph, segmentation);
+inline void OneCut::sweep(const Table2DView<RGB> & img, const vector<SweepPoint> & points, vector<SweepResult> & results){
+	results.resize(points.size());
+	float weight_potts = 0, beta_prime = 0; // setting of the graph in the solver
+	bool built = false;
+	for(int i=0;i<(int)points.size();i++)
+	{
+		const SweepPoint & point = points[i];
+		Assert((point.connectivity==0)||(point.connectivity==4)||(point.connectivity==8)||(point.connectivity==16), "grid connectivity can only be 4, 8 or 16!");
+		if((point.connectivity!=0)&&(point.connectivity!=GridConnectivity)){
+			GridConnectivity = point.connectivity;
+			computeedges(img);
+			built = false;
+		}
+		float new_potts = (float)point.weight_potts, new_beta = (float)point.beta_prime;
+		if(maxflowoption!=IBFS){
+			constructbkgraph(new_potts, new_beta);
+			maxflow();
+		}else if(!built){
+			constructbkgraph(new_potts, new_beta);
+			ibfsgraph->initGraph();
+			ibfsgraph->computeMaxFlow(true); // keep the flow valid for increments
+			flow = ibfsgraph->getFlow();
+			built = true;
+		}else{
+			// capacity differences of the integer capacities constructbkgraph() would have added
+			if(new_potts!=weight_potts){
+				for(int k=0;k<(int)edges.size();k++)
+				{
+					double oldv = weight_potts*edges[k].edgeweight, newv = new_potts*edges[k].edgeweight;
+					int delta = (int)(newv*FLOATTOINTSCALE)-(int)(oldv*FLOATTOINTSCALE);
+					if(delta!=0) ibfsgraph->incEdge(edges[k].p,edges[k].q,delta,delta);
+				}
+			}
+			if(new_beta!=beta_prime){
+				float oldw = colorseparationweight(beta_prime), neww = colorseparationweight(new_beta);
+				int delta = (int)(neww*FLOATTOINTSCALE)-(int)(oldw*FLOATTOINTSCALE);
+				if(delta!=0)
+					for(int x=0;x<img_w;x++)
+					{
+						int * bin_col = colorbinning[x];
+						for(int y=0;y<img_h;y++)
+							ibfsgraph->incEdge(x+y*img_w,bin_col[y]+img_w*img_h,delta,delta);
+					}
+			}
+			ibfsgraph->computeMaxFlow(true);
+			flow = ibfsgraph->getFlow();
+		}
+		weight_potts = new_potts;
+		beta_prime = new_beta;
+
+		SweepResult & result = results[i];
+		result.point = point;
+		result.point.connectivity = GridConnectivity;
+		result.flow = flow;
+		result.mask.resize(img_w,img_h);
+		dispatch([&](auto solver){ result.numobj = decltype(solver)::getsidespacked(*graph(solver), result.mask.data(), img_w*img_h); });
 	}
-	return segmentation;
 }
 
-void OneCut::print()
-{
-	cout<<"Image width: "<<img_w<<endl;
-	cout<<"Image height: "<<img_h<<endl;
-	cout<<"Color bin size: "<<colorbinsize<<endl;
-	cout<<"number of non-empty color bins: "<<numcolorbin<<endl;
+inline Label OneCut::hardlabel(int x, int y) const{
+	const PointPair & rect = boxstats.rect;
+	if((x<rect.p1.x)||(x>rect.p2.x)||(y<rect.p1.y)||(y>rect.p2.y)||(box[x][y]==255))
+		return BKG;
+	return seeds.isEmpty() ? NONE : seeds[x][y];
 }
 
-void OneCut::computeedges()
-{
-	int node_id = 0;
-	int img_w = img.getWidth();
-	int img_h = img.getHeight();
-	double sigma_sum = 0;
-	double sigma_square_count = 0;
-	Point kernelshifts [] = {Point(1,0),Point(0,1),Point(1,1),Point(1,-1),
-		Point(2,-1),Point(2,1),Point(1,2),Point(-1,2),};
-	for (int y=0; y<img_h; y++) // adding edges (n-links)
+inline void OneCut::buildcutproblem(CutProblem & cp, float weight_potts, float beta_prime, float ballooning){
+	cp.resize(img_w*img_h+numcolorbin);
+	for(int x=0;x<img_w;x++)
+		for(int y=0;y<img_h;y++)
+		{
+			Label h = hardlabel(x,y);
+			if(h==BKG) cp.capsink[x+y*img_w] = INT_MAX;
+			else if(h==OBJ) cp.capsource[x+y*img_w] = INT_MAX;
+			else cp.capsource[x+y*img_w] = (int)(ballooning*FLOATTOINTSCALE);
+		}
+	// same order and rounding as addsmoothnessterm() and addcolorseparation()
+	cp.edges.reserve(edges.size()+img_w*img_h);
+	for(int i=0;i<(int)edges.size();i++)
 	{
-		for (int x=0; x<img_w; x++) 
-		{ 
-			Point p(x,y);
-			for(int i=0;i<GridConnectivity/2;i++)
+		double v = weight_potts*edges[i].edgeweight;
+		cp.edges.push_back(CutEdge(edges[i].p,edges[i].q,(int)(v*FLOATTOINTSCALE)));
+	}
+	float separation_w = colorseparationweight(beta_prime);
+	for(int y=0;y<img_h;y++)
+		for(int x=0;x<img_w;x++)
+			cp.edges.push_back(CutEdge(x+y*img_w,colorbinning[x][y]+img_w*img_h,(int)(separation_w*FLOATTOINTSCALE)));
+}
+
+inline void OneCut::parametricballooning(const vector<double> & weights, Table2D<int> & firstindex, float weight_potts, float beta_prime){
+	const int K = weights.size();
+	for(int k=1;k<K;k++)
+		if(weights[k]<weights[k-1]) throw std::invalid_argument("parametricballooning() needs ascending weights");
+	CutProblem cp;
+	buildcutproblem(cp, weight_potts, beta_prime, 0);
+	const int n = cp.numnodes;
+	// the first index of node i is known to be in [lo[i],hi[i]], K meaning never
+	vector<int> lo(n,0), hi(n,K);
+	vector<char> ballooned(n,0);
+	for(int i=0;i<img_w*img_h;i++)
+	{
+		if(cp.capsink[i]==INT_MAX) lo[i] = K;
+		else if(cp.capsource[i]==INT_MAX) hi[i] = 0;
+		else ballooned[i] = 1;
+	}
+	vector<int> weightcap(K);
+	for(int k=0;k<K;k++) weightcap[k] = (int)(weights[k]*FLOATTOINTSCALE);
+
+	vector<int> part(n), extrasource(n,0), partof(K+1);
+	vector<int> partmid;
+	PartitionedCut parts;
+	while(true)
+	{
+		// every undecided interval [lo,hi] is one part, solved at the middle weight
+		partmid.clear();
+		std::fill(partof.begin(),partof.end(),-1);
+		for(int i=0;i<n;i++)
+		{
+			if(lo[i]==hi[i]){ part[i] = -1; continue; }
+			if(partof[lo[i]]<0){
+				partof[lo[i]] = partmid.size();
+				partmid.push_back((lo[i]+hi[i])/2);
+			}
+			part[i] = partof[lo[i]];
+			extrasource[i] = ballooned[i] ? weightcap[partmid[part[i]]] : 0;
+		}
+		int numparts = partmid.size();
+		if(numparts==0) break;
+		// intervals of different parts do not overlap, so a node outside part k is OBJ at its weight iff hi <= mid
+		parts.split(cp, part, numparts, [&](int q, int k){ return hi[q]<=partmid[k]; });
+
+		#pragma omp parallel for schedule(dynamic)
+		for(int k=0;k<numparts;k++)
+		{
+			IBFSGraph g(IBFSGraph::IB_INIT_FAST);
+			parts.build(k, g, &extrasource[0]);
+			g.initGraph();
+			g.computeMaxFlow(true); // complete both trees, free nodes are then on the maximal source side
+			const int * nodes = parts.getNodes(k);
+			for(int i=0;i<parts.getNumNodes(k);i++)
 			{
-				Point q = p + kernelshifts[i];
-				if(img.pointIn(q))
-				{
-					sigma_sum += dI(img[p],img[q]);
-					sigma_square_count ++;
-				}
+				if(g.isNodeOnSrcSide(i,1)) hi[nodes[i]] = partmid[k];
+				else lo[nodes[i]] = partmid[k]+1;
 			}
 		}
 	}
+	firstindex.resize(img_w,img_h);
+	for(int x=0;x<img_w;x++)
+		for(int y=0;y<img_h;y++)
+			firstindex[x][y] = lo[x+y*img_w];
+}
 
-	double sigma_square = sigma_sum/sigma_square_count;
-	for (int y=0; y<img_h; y++) // adding edges (n-links)
+inline void OneCut::runreduced(Table2D<Label> & segmentation, float weight_potts, float beta_prime){
+	buildcutproblem(reducedproblem, weight_potts, beta_prime);
+	reduction.reduce(reducedproblem);
+	vector<unsigned char> label;
+	if(maxflowoption==BK){
+		GraphType g(reduction.getNumNodes(), reduction.getNumEdges());
+		reduction.build(g);
+		flow = (g.maxflow()+reduction.getOffset())/FLOATTOINTSCALE; // in the units of run() with BK
+		reduction.expand([&](int i){ return g.what_segment(i)==GraphType::SOURCE; }, label);
+	}else if(maxflowoption==PUSHRELABEL){
+		PushRelabelGraph g;
+		reduction.build(g);
+		flow = (double)(g.computeMaxFlow()+reduction.getOffset());
+		reduction.expand([&](int i){ return g.isNodeOnSrcSide(i); }, label);
+	}else{ // IBFS and GRID
+		IBFSGraph g(IBFSGraph::IB_INIT_FAST);
+		reduction.build(g);
+		g.initGraph();
+		g.computeMaxFlow(true); // maximal min cut, as the reduction assumes
+		flow = (double)g.getFlow()+reduction.getOffset();
+		reduction.expand([&](int i){ return g.isNodeOnSrcSide(i,1)!=0; }, label);
+	}
+	segmentation.resize(img_w,img_h);
+	for(int x=0;x<img_w;x++)
 	{
-		for (int x=0; x<img_w; x++) 
-		{ 
-			Point p(x,y);
-			for(int i=0;i<GridConnectivity/2;i++)
+		Label * seg_col = segmentation[x];
+		for(int y=0;y<img_h;y++)
+			seg_col[y] = label[x+y*img_w] ? OBJ : BKG;
+	}
+}
+
+inline int OneCut::runcomponents(Table2D<Label> & segmentation, float weight_potts, float beta_prime){
+	CutProblem cp;
+	buildcutproblem(cp, weight_potts, beta_prime);
+	vector<unsigned char> label;
+	int numcomponents = 0;
+	flow = (double)solvecomponents(cp, label, &numcomponents);
+	segmentation.resize(img_w,img_h);
+	for(int x=0;x<img_w;x++)
+	{
+		Label * seg_col = segmentation[x];
+		for(int y=0;y<img_h;y++)
+			seg_col[y] = label[x+y*img_w] ? OBJ : BKG;
+	}
+	return numcomponents;
+}
+
+inline void OneCut::runboxes(const vector<PointPair> & rects, vector<BoxResult> & results, float weight_potts, float beta_prime){
+	results.resize(rects.size());
+	const int numshifts = GridConnectivity/2;
+	#pragma omp parallel
+	{
+		// per thread: the hub of each bin (-1 if none), and of each hub its bin and number of box pixels
+		vector<int> hubof(numcolorbin,-1), hubbin, hubcount;
+		vector<long long> capsource, capsink;
+		#pragma omp for schedule(dynamic)
+		for(int k=0;k<(int)rects.size();k++)
+		{
+			BoxResult & result = results[k];
+			const int x1 = max(rects[k].p1.x,0), y1 = max(rects[k].p1.y,0);
+			const int x2 = min(rects[k].p2.x,img_w-1), y2 = min(rects[k].p2.y,img_h-1);
+			result.rect = PointPair(x1,y1,x2,y2);
+			result.flow = 0;
+			result.numobj = 0;
+			if((x1>x2)||(y1>y2)){ result.mask.resize(0,0); continue; }
+			const int bw = x2-x1+1, bh = y2-y1+1, boxsize = bw*bh;
+
+			// color bins of the box, box statistics as in setbox()
+			hubbin.clear();
+			hubcount.clear();
+			for(int y=y1;y<=y2;y++)
+				for(int x=x1;x<=x2;x++)
+				{
+					int bin = colorbinning[x][y];
+					if(hubof[bin]<0){
+						hubof[bin] = hubbin.size();
+						hubbin.push_back(bin);
+						hubcount.push_back(0);
+					}
+					hubcount[hubof[bin]]++;
+				}
+			const int numhubs = hubbin.size();
+			int l1overlap = 0;
+			for(int h=0;h<numhubs;h++)
+				l1overlap += min(hubcount[h],binhist[hubbin[h]]-hubcount[h]);
+			float separation_w = (float)boxsize/(float)max(l1overlap,1)*beta_prime; // as colorseparationweight()
+			int separation = (int)(separation_w*FLOATTOINTSCALE);
+
+			IBFSGraph g(IBFSGraph::IB_INIT_FAST);
+			g.initSize(boxsize+numhubs, boxsize*(numshifts+1));
+			capsource.assign(boxsize+numhubs,0);
+			capsink.assign(boxsize+numhubs,0);
+			for(int i=0;i<boxsize;i++) capsource[i] = 1*FLOATTOINTSCALE; // ballooning
+			// n-links with an end in the box: edges are in node order of p and p is at most two rows above or
+			// one row below and two columns left or one right of q, so every row of candidates p is one range
+			// of edges
+			for(int y=max(y1-2,0);y<=min(y2+1,img_h-1);y++)
 			{
-				Point q = p + kernelshifts[i];
-				if(img.pointIn(q))
+				int first = max(x1-2,0)+y*img_w, last = min(x2+1,img_w-1)+y*img_w;
+				vector<Edge<double> >::const_iterator e = std::lower_bound(edges.begin(),edges.end(),first,
+					[](const Edge<double> & edge, int p){ return edge.p<p; });
+				for(;(e!=edges.end())&&(e->p<=last);++e)
 				{
-					edges.push_back(Edge<double>(p.x+p.y*img_w,q.x+q.y*img_w,Gaussian(dI(img[p],img[q]),1.0,sigma_square)/(p-q).norm()));
+					int px = e->p-y*img_w, qx = e->q%img_w, qy = e->q/img_w;
+					bool pin = (px>=x1)&&(px<=x2)&&(y>=y1)&&(y<=y2);
+					bool qin = (qx>=x1)&&(qx<=x2)&&(qy>=y1)&&(qy<=y2);
+					if(!pin&&!qin) continue;
+					double v = weight_potts*e->edgeweight;
+					int cap = (int)(v*FLOATTOINTSCALE); // as in addsmoothnessterm()
+					int lp = (px-x1)+(y-y1)*bw, lq = (qx-x1)+(qy-y1)*bw;
+					if(pin&&qin) g.addEdge(lp,lq,cap,cap);
+					else capsink[pin ? lp : lq] += cap; // the other pixel is outside, BKG
 				}
 			}
+			for(int y=y1;y<=y2;y++)
+				for(int x=x1;x<=x2;x++)
+					g.addEdge((x-x1)+(y-y1)*bw,boxsize+hubof[colorbinning[x][y]],separation,separation);
+			for(int h=0;h<numhubs;h++) // arcs to the pixels of the bin outside the box
+				capsink[boxsize+h] += (long long)separation*(binhist[hubbin[h]]-hubcount[h]);
+			long long flowoffset = 0; // flow of the whole image graph straight from source to sink
+			for(int i=0;i<boxsize+numhubs;i++)
+			{
+				// only the difference matters, clipped to the int capacities as in PartitionedCut
+				long long net = max(min(capsource[i]-capsink[i],(long long)INT_MAX),-(long long)INT_MAX);
+				g.addNode(i,net>0 ? (int)net : 0,net<0 ? (int)-net : 0);
+				flowoffset += min(capsource[i],capsink[i]);
+			}
+			g.initGraph();
+			g.computeMaxFlow(true);
+			result.flow = (double)g.getFlow()+flowoffset;
+			result.mask.resize(bw,bh);
+			result.numobj = g.getNodeSidesPacked(result.mask.data(),0,boxsize,true);
+			for(int h=0;h<numhubs;h++) hubof[hubbin[h]] = -1;
 		}
 	}
+}
 
+inline void OneCut::setsuperpixels(const SuperPixels & sp){
+	const Table2D<int> & labels = sp.getLabels();
+	Assert((labels.getWidth()==img_w)&&(labels.getHeight()==img_h),"superpixels must match the image size");
+	numsp = sp.getNumSuperPixels();
+	spofnode.resize(img_w*img_h);
+	for(int x=0;x<img_w;x++)
+		for(int y=0;y<img_h;y++)
+			spofnode[x+y*img_w] = labels[x][y];
+	// pixels bucketed by superpixel
+	spstart.assign(numsp+1,0);
+	for(int i=0;i<img_w*img_h;i++) spstart[spofnode[i]+1]++;
+	for(int k=0;k<numsp;k++) spstart[k+1] += spstart[k];
+	sppixels.resize(img_w*img_h);
+	vector<int> fill(spstart.begin(),spstart.end()-1);
+	for(int i=0;i<img_w*img_h;i++) sppixels[fill[spofnode[i]]++] = i;
+	// pairs of superpixels joined by a pixel edge
+	vector<long long> pairs;
+	for(int i=0;i<(int)edges.size();i++)
+	{
+		int a = spofnode[edges[i].p], b = spofnode[edges[i].q];
+		if(a!=b) pairs.push_back((long long)min(a,b)*numsp+max(a,b));
+	}
+	sort(pairs.begin(),pairs.end());
+	pairs.erase(unique(pairs.begin(),pairs.end()),pairs.end());
+	spadjstart.assign(numsp+1,0);
+	spadj.resize(pairs.size());
+	for(size_t i=0;i<pairs.size();i++)
+	{
+		spadjstart[pairs[i]/numsp+1]++;
+		spadj[i] = (int)(pairs[i]%numsp);
+	}
+	for(int k=0;k<numsp;k++) spadjstart[k+1] += spadjstart[k];
 }
 
+inline void OneCut::constructsuperpixelgraph(float weight_potts, float beta_prime){
+	Assert(numsp>0,"setsuperpixels() before constructsuperpixelgraph()");
+	releasegraphs();
+	spweight_potts = weight_potts;
+	spbeta_prime = beta_prime;
+	const int n = img_w*img_h;
+	sphardnode.resize(n);
+	for(int x=0;x<img_w;x++)
+		for(int y=0;y<img_h;y++)
+			sphardnode[x+y*img_w] = hardlabel(x,y);
 
-void OneCut::computebinning(){
-	colorbinning= Table2D<int>(img_w,img_h);
-	RGB rgb_v;
-	int r_idx =0, g_idx = 0, b_idx = 0, idx =0;
-	int binperchannel = (int)ceil(256.0/colorbinsize);
-	for(unsigned int j=0;j<img_h;j++)
+	// t-links of superpixels and bins: ballooning of the free pixels and everything folded from hard pixels
+	spfoldsource.assign(numsp+numcolorbin,0);
+	spfoldsink.assign(numsp+numcolorbin,0);
+	sppaircap.assign(spadj.size(),0);
+	for(int i=0;i<(int)edges.size();i++)
 	{
-		for(unsigned int i=0;i<img_w;i++)
-		{
-			rgb_v = img[i][j];
-			r_idx = (int)(rgb_v.r/colorbinsize);
-			g_idx = (int)(rgb_v.g/colorbinsize);
-			b_idx = (int)(rgb_v.b/colorbinsize);
-			idx = r_idx + g_idx*binperchannel+b_idx*binperchannel*binperchannel;
-			colorbinning[i][j] = idx;
+		int p = edges[i].p, q = edges[i].q;
+		Label hp = sphardnode[p], hq = sphardnode[q];
+		if((hp!=NONE)&&(hq!=NONE)) continue; // constant
+		double v = weight_potts*edges[i].edgeweight;
+		int cap = (int)(v*FLOATTOINTSCALE); // as in addsmoothnessterm()
+		int a = spofnode[p], b = spofnode[q];
+		if((hp==NONE)&&(hq==NONE)){
+			if(a==b) continue; // never cut
+			if(a>b) std::swap(a,b);
+			int e = spadjstart[a];
+			while(spadj[e]!=b) e++;
+			sppaircap[e] += cap;
 		}
+		else if(hp==NONE) (hq==OBJ ? spfoldsource : spfoldsink)[a] += cap;
+		else (hp==OBJ ? spfoldsource : spfoldsink)[b] += cap;
 	}
-	// sparse binning
-	vector<int> colorhist(binperchannel*binperchannel*binperchannel,0);
-	for(unsigned int j=0;j<img_h;j++)
+	int separation = (int)(colorseparationweight(beta_prime)*FLOATTOINTSCALE); // as in addcolorseparation()
+	vector<Edge<int> > binarcs; // (superpixel, bin, number of its free pixels in the bin)
+	spbincount.assign(numcolorbin,0);
+	for(int k=0;k<numsp;k++)
 	{
-		for(unsigned int i=0;i<img_w;i++)
+		size_t first = binarcs.size();
+		for(int i=spstart[k];i<spstart[k+1];i++)
 		{
-			colorhist[colorbinning[i][j]] = colorhist[colorbinning[i][j]]+1;
+			int p = sppixels[i], bin = colorbinning[p%img_w][p/img_w];
+			if(sphardnode[p]==NONE){
+				spfoldsource[k] += FLOATTOINTSCALE; // ballooning
+				if(spbincount[bin]++==0) binarcs.push_back(Edge<int>(k,bin,0));
+			}
+			else (sphardnode[p]==OBJ ? spfoldsource : spfoldsink)[numsp+bin] += separation;
+		}
+		for(size_t i=first;i<binarcs.size();i++)
+		{
+			binarcs[i].edgeweight = spbincount[binarcs[i].q];
+			spbincount[binarcs[i].q] = 0;
 		}
 	}
-	
-	vector<int> correspondence(colorhist.size(),-1);
-	int compactcount = 0;
-	for(int i=0;i<colorhist.size();i++)
+
+	void * mem = (arena!=NULL) ? arena->alloc(sizeof(IBFSGraph)) : ::operator new(sizeof(IBFSGraph));
+	ibfsgraph = new (mem) IBFSGraph(IBFSGraph::IB_INIT_FAST, arena);
+	ibfsgraph->initSize(numsp+numcolorbin,spadj.size()+binarcs.size());
+	spflowoffset = 0;
+	for(int i=0;i<numsp+numcolorbin;i++)
 	{
-		if(colorhist[i]!=0)
+		// only the difference matters, clipped to the int capacities as in PartitionedCut,
+		// the common part is paid by either label
+		spflowoffset += min(spfoldsource[i],spfoldsink[i]);
+		long long net = max(min(spfoldsource[i]-spfoldsink[i],(long long)INT_MAX),-(long long)INT_MAX);
+		ibfsgraph->addNode(i,net>0 ? (int)net : 0,net<0 ? (int)-net : 0);
+	}
+	for(int a=0;a<numsp;a++)
+		for(int e=spadjstart[a];e<spadjstart[a+1];e++)
 		{
-			correspondence[i] = compactcount;
-			compactcount++;
+			int cap = (int)min(sppaircap[e],(long long)INT_MAX);
+			if(cap>0) ibfsgraph->addEdge(a,spadj[e],cap,cap);
 		}
+	for(size_t i=0;i<binarcs.size();i++)
+	{
+		int cap = (int)min((long long)separation*binarcs[i].edgeweight,(long long)INT_MAX);
+		ibfsgraph->addEdge(binarcs[i].p,numsp+binarcs[i].q,cap,cap);
 	}
-	for(int j=0;j<img_h;j++)
+}
+
+inline void OneCut::runsuperpixels(Table2D<Label> & segmentation, int refineband){
+	ibfsgraph->initGraph();
+	ibfsgraph->computeMaxFlow(true); // both trees complete, free nodes are on the maximal source side
+	flow = ibfsgraph->getFlow()+spflowoffset;
+	splabeling.resize(numsp);
+	for(int k=0;k<numsp;k++)
+		splabeling[k] = ibfsgraph->isNodeOnSrcSide(k,999) ? OBJ : BKG;
+	segmentation.resize(img_w,img_h);
+	for(int x=0;x<img_w;x++)
+		for(int y=0;y<img_h;y++)
+		{
+			int p = x+y*img_w;
+			segmentation[x][y] = (sphardnode[p]!=NONE) ? sphardnode[p] : splabeling[spofnode[p]];
+		}
+	if(refineband>0)
+		refinesuperpixels(segmentation, refineband);
+}
+
+// solves the pixel graph of constructbkgraph() on the free pixels near the object boundary, n-links and
+// color separation arcs to the other pixels are folded into t-links of the band pixels and of the bins
+inline void OneCut::refinesuperpixels(Table2D<Label> & segmentation, int refineband){
+	const int n = img_w*img_h;
+	vector<int> & band = spband; // index of a band pixel in the refinement graph, -1 elsewhere
+	band.assign(n,-1);
+	for(int x=0;x<img_w;x++)
+		for(int y=0;y<img_h;y++)
+		{
+			bool boundary = ((x+1<img_w)&&(segmentation[x][y]!=segmentation[x+1][y]))
+				||((y+1<img_h)&&(segmentation[x][y]!=segmentation[x][y+1]));
+			if(!boundary) continue;
+			for(int bx=max(x-refineband,0);bx<=min(x+1+refineband,img_w-1);bx++)
+				for(int by=max(y-refineband,0);by<=min(y+1+refineband,img_h-1);by++)
+					band[bx+by*img_w] = 0;
+		}
+	int numband = 0;
+	for(int i=0;i<n;i++)
+		if((band[i]==0)&&(sphardnode[i]==NONE)) band[i] = numband++;
+		else band[i] = -1;
+	if(numband==0) return;
+
+	spfoldsource.assign(numband+numcolorbin,0);
+	spfoldsink.assign(numband+numcolorbin,0);
+	IBFSGraph g(IBFSGraph::IB_INIT_FAST);
+	g.initSize(numband+numcolorbin,numband*(GridConnectivity/2+1));
+	for(int i=0;i<(int)edges.size();i++)
 	{
-		for(int i=0;i<img_w;i++)
+		int a = band[edges[i].p], b = band[edges[i].q];
+		if((a<0)&&(b<0)) continue;
+		double v = spweight_potts*edges[i].edgeweight;
+		int cap = (int)(v*FLOATTOINTSCALE);
+		if((a>=0)&&(b>=0)) { g.addEdge(a,b,cap,cap); continue; }
+		int inside = (a>=0) ? a : b, outside = (a>=0) ? edges[i].q : edges[i].p;
+		if(segmentation[outside%img_w][outside/img_w]==OBJ) spfoldsource[inside] += cap;
+		else spfoldsink[inside] += cap;
+	}
+	int separation = (int)(colorseparationweight(spbeta_prime)*FLOATTOINTSCALE);
+	for(int y=0;y<img_h;y++)
+		for(int x=0;x<img_w;x++)
 		{
-			colorbinning[i][j] = correspondence[colorbinning[i][j]];
+			int bin = numband+colorbinning[x][y], a = band[x+y*img_w];
+			if(a>=0) g.addEdge(a,bin,separation,separation);
+			else if(segmentation[x][y]==OBJ) spfoldsource[bin] += separation;
+			else spfoldsink[bin] += separation;
 		}
+	for(int i=0;i<numband+numcolorbin;i++)
+	{
+		// only the difference matters, clipped to the int capacities as in PartitionedCut
+		long long net = spfoldsource[i]-spfoldsink[i]+((i<numband) ? FLOATTOINTSCALE : 0);
+		net = max(min(net,(long long)INT_MAX),-(long long)INT_MAX);
+		g.addNode(i,net>0 ? (int)net : 0,net<0 ? (int)-net : 0);
 	}
-	
+	g.initGraph();
+	g.computeMaxFlow(true);
+	for(int i=0;i<n;i++)
+		if(band[i]>=0)
+			segmentation[i%img_w][i/img_w] = g.isNodeOnSrcSide(band[i],999) ? OBJ : BKG;
+}
+
+inline Table2D<Label> OneCut::run(){
+	Table2D<Label> segmentation(img_w,img_h,NONE);
+	run(segmentation);
+	return segmentation;
+}
+
+inline void OneCut::maxflow(){
+	dispatch([&](auto solver){ flow = decltype(solver)::solve(*graph(solver)); });
+}
+
+inline void OneCut::run(Table2D<Label> & segmentation){
+	segmentation.resize(img_w,img_h);
+	dispatch([&](auto solver){
+		typedef decltype(solver) S;
+		typename S::Graph & g = *graph(solver);
+		flow = S::solve(g);
+		for(int x=0;x<img_w;x++)
+		{
+			Label * seg_col = segmentation[x];
+			for(int y=0;y<img_h;y++)
+				seg_col[y] = S::onsource(g,x+y*img_w) ? OBJ : BKG;
+		}
+	});
+}
+
+inline int OneCut::run(unsigned char * mask, unsigned char objvalue, unsigned char bkgvalue){
+	// free nodes go to the foreground, as in getgraphlabeling(IBFS)
+	int numobj = 0;
+	dispatch([&](auto solver){
+		typedef decltype(solver) S;
+		flow = S::solve(*graph(solver));
+		numobj = S::getsides(*graph(solver), mask, img_w*img_h, objvalue, bkgvalue);
+	});
+	return numobj;
+}
+
+inline int OneCut::runpacked(unsigned char * bits){
+	int numobj = 0;
+	dispatch([&](auto solver){
+		typedef decltype(solver) S;
+		flow = S::solve(*graph(solver));
+		numobj = S::getsidespacked(*graph(solver), bits, img_w*img_h);
+	});
+	return numobj;
 }
 
-// Color histogram overlap of box and its outside region based on L1 metric
-int getl1penalty(Table2D<int> & colorbinning,Table2D<int> & box)
+inline int OneCut::run(BitMask & mask){
+	mask.resize(img_w,img_h);
+	return runpacked(mask.data());
+}
+
+inline int OneCut::run(RLEMask & mask){
+	int numobj = run(rlescratch);
+	mask.encode(rlescratch);
+	return numobj;
+}
+
+inline void OneCut::print()
 {
-	int returnv = 0;
-	int bin_num = colorbinning.getMax()+1;
-	vector<int> obj_vector(bin_num,0);
-	vector<int> bkg_vector(bin_num,0);
-	for(int j=0;j<box.getHeight();j++)
+	cout<<"Image width: "<<img_w<<endl;
+	cout<<"Image height: "<<img_h<<endl;
+	if(binningoption==MEDIANCUT)
+		cout<<"Median cut bins: "<<numbins<<endl;
+	else
+		cout<<"Color bin size: "<<colorbinsize<<endl;
+	cout<<"number of non-empty color bins: "<<numcolorbin<<endl;
+}
+
+inline void OneCut::computeedges(const Table2DView<RGB> & img)
+{
+	// the only branch on the connectivity, the loops below are specialized for it
+	if(GridConnectivity==4) computeedges<4>(img);
+	else if(GridConnectivity==8) computeedges<8>(img);
+	else computeedges<16>(img);
+}
+
+template<int C>
+void OneCut::computeedges(const Table2DView<RGB> & img)
+{
+	double sigma_sum = 0;
+	double sigma_square_count = 0;
+	forgridneighbors<C>(img_w, img_h, [&](Point p, Point q, int i){
+		sigma_sum += dI(img[p],img[q]);
+		sigma_square_count ++;
+	});
+
+	double sigma_square = sigma_sum/sigma_square_count;
+	double norm[GridShifts<C>::count];
+	for(int i=0;i<GridShifts<C>::count;i++)
+		norm[i] = Point(gridshiftx[i],gridshifty[i]).norm();
+	edges.clear(); // keeps the capacity of the previous image
+	edges.reserve(GridShifts<C>::count*img_w*img_h);
+	forgridneighbors<C>(img_w, img_h, [&](Point p, Point q, int i){ // adding edges (n-links)
+		edges.push_back(Edge<double>(p.x+p.y*img_w,q.x+q.y*img_w,Gaussian(dI(img[p],img[q]),1.0,sigma_square)/norm[i]));
+	});
+}
+
+inline void OneCut::computebinning(const Table2DView<RGB> & img){
+	colorbinning.resizePadded(img_w,img_h); // every column starts aligned
+	int binperchannel = (int)ceil(256.0/colorbinsize);
+	// per-channel lookup tables fold the division and the channel stride into one load each
+	int r_lut[256], g_lut[256], b_lut[256];
+	for(int v=0;v<256;v++)
 	{
-		for(int i=0;i<box.getWidth();i++)
+		r_lut[v] = v/colorbinsize;
+		g_lut[v] = (v/colorbinsize)*binperchannel;
+		b_lut[v] = (v/colorbinsize)*binperchannel*binperchannel;
+	}
+	// sparse binning: open addressing table from bin index to compact index,
+	// sized to the number of occupied bins instead of binperchannel^3
+	unsigned int hashmask = 1023;
+	vector<int> & hashkey = binhashkey;
+	vector<int> & hashval = binhashval;
+	vector<int> & occupied = binoccupied; // bin index of each compact index, in order of first occurrence
+	hashkey.assign(hashmask+1,-1);
+	hashval.resize(hashmask+1);
+	occupied.clear();
+	int lastidx = -1, lastcompact = -1;
+	for(int i=0;i<img_w;i++)
+	{
+		RGB * img_col = img[i];
+		int * bin_col = colorbinning[i];
+		for(int j=0;j<img_h;j++)
 		{
-			if(box[i][j] == 0)
+			int idx = r_lut[img_col[j].r] + g_lut[img_col[j].g] + b_lut[img_col[j].b];
+			if(idx!=lastidx) // neighboring pixels mostly share a bin
 			{
-				obj_vector[colorbinning[i][j]]++;
+				unsigned int h = ((unsigned int)idx*2654435761u)&hashmask;
+				while((hashkey[h]!=idx)&&(hashkey[h]!=-1))
+					h = (h+1)&hashmask;
+				if(hashkey[h]==idx)
+					lastcompact = hashval[h];
+				else
+				{
+					lastcompact = occupied.size();
+					hashkey[h] = idx;
+					hashval[h] = lastcompact;
+					occupied.push_back(idx);
+					if(occupied.size()*2>hashmask) // keep the load factor below 1/2
+					{
+						hashmask = hashmask*2+1;
+						hashkey.assign(hashmask+1,-1);
+						hashval.resize(hashmask+1);
+						for(int k=0;k<(int)occupied.size();k++)
+						{
+							h = ((unsigned int)occupied[k]*2654435761u)&hashmask;
+							while(hashkey[h]!=-1)
+								h = (h+1)&hashmask;
+							hashkey[h] = occupied[k];
+							hashval[h] = k;
+						}
+					}
+				}
+				lastidx = idx;
 			}
-			else
-				bkg_vector[colorbinning[i][j]]++;
+			bin_col[j] = lastcompact;
 		}
 	}
-	for(int i=0;i<bin_num;i++)
+	// bins are numbered in order of first occurrence, the order of the hubs does not change the cut
+	numcolorbin = occupied.size();
+}
+
+// median cut palette on a histogram of 6 bits per channel: the box of histogram cells holding the most
+// pixels is split at the weighted median of its longest channel, until there are numbins boxes or
+// every box is a single cell. Bins are the boxes, each holds at least one pixel.
+inline void OneCut::computebinningmediancut(const Table2DView<RGB> & img){
+	Assert(numbins>=1, "median cut needs at least one bin");
+	colorbinning.resizePadded(img_w,img_h);
+	cellcount.assign(1<<18,0);
+	for(int x=0;x<img_w;x++)
 	{
-		returnv+=min(obj_vector[i],bkg_vector[i]);
+		RGB * img_col = img[x];
+		int * bin_col = colorbinning[x];
+		for(int y=0;y<img_h;y++)
+		{
+			int c = ((img_col[y].r>>2)<<12)|((img_col[y].g>>2)<<6)|(img_col[y].b>>2);
+			bin_col[y] = c; // the cell for now, mapped to its bin below
+			cellcount[c]++;
+		}
+	}
+	cells.clear();
+	for(int c=0;c<(1<<18);c++)
+		if(cellcount[c]>0) cells.push_back(c);
+
+	// a box is the range [begin,end) of cells, split boxes are ranges of the sorted cells
+	struct Box{int begin, end, count;};
+	vector<Box> boxes(1);
+	boxes[0].begin = 0; boxes[0].end = cells.size(); boxes[0].count = img_w*img_h;
+	std::priority_queue<pair<int,int> > queue; // (pixels, box) of the boxes with more than one cell
+	if(cells.size()>1) queue.push(make_pair(boxes[0].count,0));
+	while(((int)boxes.size()<numbins)&&!queue.empty())
+	{
+		int b = queue.top().second;
+		queue.pop();
+		Box box = boxes[b];
+		int lo[3] = {63,63,63}, hi[3] = {0,0,0};
+		for(int i=box.begin;i<box.end;i++)
+			for(int ch=0;ch<3;ch++)
+			{
+				int v = (cells[i]>>(12-6*ch))&63;
+				lo[ch] = min(lo[ch],v);
+				hi[ch] = max(hi[ch],v);
+			}
+		int ch = 0;
+		for(int k=1;k<3;k++)
+			if(hi[k]-lo[k]>hi[ch]-lo[ch]) ch = k;
+		int shift = 12-6*ch;
+		std::sort(cells.begin()+box.begin,cells.begin()+box.end,[shift](int a, int b){
+			return make_pair((a>>shift)&63,a)<make_pair((b>>shift)&63,b);
+		});
+		// the first half of the pixels goes to the left box, each side keeps at least one cell
+		int split = box.begin, left = 0;
+		while((split<box.end-1)&&((left==0)||(2*(left+cellcount[cells[split]])<=box.count)))
+			left += cellcount[cells[split++]];
+		Box right = {split, box.end, box.count-left};
+		boxes[b].end = split;
+		boxes[b].count = left;
+		boxes.push_back(right);
+		if(split-box.begin>1) queue.push(make_pair(left,b));
+		if(box.end-split>1) queue.push(make_pair(right.count,(int)boxes.size()-1));
+	}
+	numcolorbin = boxes.size();
+
+	cellbin.resize(1<<18);
+	for(int b=0;b<numcolorbin;b++)
+		for(int i=boxes[b].begin;i<boxes[b].end;i++)
+			cellbin[cells[i]] = b;
+	for(int x=0;x<img_w;x++)
+	{
+		int * bin_col = colorbinning[x];
+		for(int y=0;y<img_h;y++)
+			bin_col[y] = cellbin[bin_col[y]];
 	}
-	return returnv;
 }
 
 // add L1 color separation term to the graph
 // ROI is the region of interest
 // separation_w is the weight of the color separation term
-void OneCut::addcolorseparation(const Table2D<int> &colorlabel,float separation_w)
+inline void OneCut::addcolorseparation(const Table2D<int> &colorlabel,float separation_w)
+{
+	dispatch([&](auto solver){ addcolorseparation(solver, colorlabel, separation_w); });
+}
+
+template<class S> inline void OneCut::addcolorseparation(S solver, const Table2D<int> &colorlabel, float separation_w)
 {
-	int node_id = 0;
+	typename S::Graph & g = *graph(solver);
+	const typename S::Cap cap = S::cap(separation_w);
 	int img_w = colorlabel.getWidth();
 	int img_h = colorlabel.getHeight();
 	for(int y=0; y<img_h; y++) // adding links to auxiliary nodes
 	{
 		for(int x=0; x<img_w; x++) 
-		{ 
-			node_id = x+y*img_w;
-			if(maxflowoption == BK)
-				bkgraph->add_edge( node_id, colorlabel[x][y]+img_w*img_h,separation_w, separation_w);
-			else if(maxflowoption == IBFS)
-				ibfsgraph->addEdge(node_id, colorlabel[x][y]+img_w*img_h,(int)(separation_w*FLOATTOINTSCALE), (int)(separation_w*FLOATTOINTSCALE));
-		}
+			S::addedge(g, x+y*img_w, colorlabel[x][y]+img_w*img_h, cap);
 	}
 }
 
@@ -303,20 +1196,13 @@ void OneCut::addcolorseparation(const Table2D<int> &colorlabel,float separation_
 // add smoothness term to the graph
 // lambda is the weight of the smoothness term
 // ROI is the region of interest
-void OneCut::addsmoothnessterm(double lambda)
+inline void OneCut::addsmoothnessterm(double lambda)
 {
-	// number of neighboring pairs of pixels
-	int numNeighbor = edges.size();
-	// n-link - smoothness term
-	int node_id1 =0, node_id2 =0;
-	
-	for(int i=0;i<numNeighbor;i++)
-	{
-		Edge<double> edge = edges[i];
-		double v = lambda*edges[i].edgeweight;
-		if(maxflowoption == BK)
-			bkgraph->add_edge(edge.p,edge.q,v,v);
-		else if(maxflowoption == IBFS)
-			ibfsgraph->addEdge(edge.p,edge.q,(int)(v*FLOATTOINTSCALE),(int)(v*FLOATTOINTSCALE));
-	}
-}
\ No newline at end of file
+	dispatch([&](auto solver){ addsmoothnessterm(solver, lambda); });
+}
+
+template<class S> inline void OneCut::addsmoothnessterm(S solver, double lambda)
+{
+	// n-link - smoothness term, one per neighboring pair of pixels
+	S::addedges(*graph(solver), edges.data(), edges.size(), lambda);
+}
@@ -0,0 +1,283 @@
+#pragma once
+#include "OneCut.h"
+#include "ezi/Table3D.h"
+
+// OneCut on volumes (CT/MR): voxels x+y*vol_w+z*vol_w*vol_h are the nodes, the box is a cuboid and the color
+// separation term works on intensity bins. n-links have the contrast weights of the 2D grid, with dI the
+// squared intensity difference. IBFS runs in IB_INIT_DIRECT mode: a first pass over the neighbors gives the
+// degree of every node, then the arcs are written in place slice by slice with weights computed from the
+// volume, no edge list is kept: the graph takes the 2 arcs of 24 bytes per edge and the nodes.
+//
+// Size limits: voxels+bins < INT_MAX nodes and edges (n-links plus one arc per voxel) < INT_MAX, so a
+// 512^3 volume fits at 6, 18 and 26-connectivity (5.4e8, 1.3e9 and 1.9e9 edges). The flow is counted in
+// long long. constructgraph() throws std::length_error beyond these limits.
+//
+//		Table3D<float> volume(w, h, d);           // intensities, e.g. in Hounsfield units
+//		OneCut3D onecut(volume, 32, 6);            // intensity bins of 32, 6-connected
+//		onecut.constructgraph(volume, Cuboid(x1,y1,z1,x2,y2,z2), 9.0);
+//		Table3D<unsigned char> mask;
+//		onecut.run(mask);                          // 1 = object, 0 = background
+
+// neighborhood of the volume grid: connectivity C (6, 18 or 26) uses the first C/2 shifts, each pair of
+// neighbors once. All shifts have dz >= 0, so the n-links of slice z only reach slice z+1.
+static const int volumeshiftx[13] = {1,0,0, 1,1,1,-1,0,0, 1,1,-1,-1};
+static const int volumeshifty[13] = {0,1,0, 1,-1,0,0,1,-1, 1,-1,1,-1};
+static const int volumeshiftz[13] = {0,0,1, 0,0,1,1,1,1, 1,1,1,1};
+template<int C>
+struct VolumeShifts
+{
+	static const int count = C/2;
+	static const int minx = (C==6) ? 0 : -1;
+	static const int miny = (C==6) ? 0 : -1;
+	// maxx = maxy = maxz = 1, minz = 0
+};
+
+// calls f(p,q,i) for every voxel p of slice z and neighbor q = p+shift i inside a w x h x d volume, in node
+// order of p and then in shift order. As forgridneighbors(), the interior skips the bounds checks.
+template<int C, class F>
+inline void forvolumeneighbors(int w, int h, int d, int z, F f)
+{
+	typedef VolumeShifts<C> S;
+	const long long slicesize = (long long)w*h;
+	int offset[S::count];
+	for(int i=0;i<S::count;i++)
+		offset[i] = volumeshiftx[i]+volumeshifty[i]*w+volumeshiftz[i]*(int)slicesize;
+	const bool slicein = (z+1<d);
+	for(int y=0;y<h;y++)
+	{
+		bool rowin = slicein&&(y+S::miny>=0)&&(y+1<h);
+		int xa = rowin ? std::min(-S::minx,w) : w; // interior voxels [xa,xb) of the row
+		int xb = rowin ? std::max(w-1,xa) : w;
+		int p = (int)(y*w+z*slicesize);
+		for(int x=0;x<w;x++,p++)
+		{
+			if(x==xa)
+			{
+				for(;x<xb;x++,p++)
+				{
+					#pragma GCC unroll 13
+					for(int i=0;i<S::count;i++)
+						f(p,p+offset[i],i);
+				}
+				if(x==w) break;
+			}
+			for(int i=0;i<S::count;i++)
+			{
+				int qx = x+volumeshiftx[i], qy = y+volumeshifty[i], qz = z+volumeshiftz[i];
+				if((qx>=0)&&(qx<w)&&(qy>=0)&&(qy<h)&&(qz<d))
+					f(p,p+offset[i],i);
+			}
+		}
+	}
+}
+
+// axis aligned box of voxels, corners included
+struct Cuboid
+{
+	Cuboid(int x1_ = 0, int y1_ = 0, int z1_ = 0, int x2_ = -1, int y2_ = -1, int z2_ = -1)
+		:x1(x1_),y1(y1_),z1(z1_),x2(x2_),y2(y2_),z2(z2_){}
+	int x1, y1, z1, x2, y2, z2;
+	bool contains(int x, int y, int z) const {return (x>=x1)&&(x<=x2)&&(y>=y1)&&(y<=y2)&&(z>=z1)&&(z<=z2);}
+};
+
+class OneCut3D{
+public:
+	OneCut3D();
+	// the volume is only read by setvolume() and constructgraph(), OneCut3D keeps no copy of it
+	OneCut3D(const Table3D<float> & vol, double binsize_, int connectivity_ = 6);
+	~OneCut3D();
+	// (re)initialize for a new volume: intensity bins of binsize_ and the contrast normalization
+	void setvolume(const Table3D<float> & vol, double binsize_, int connectivity_ = 6);
+	// as OneCut::setarena()
+	void setarena(MemArena * arena_) {releasegraph(); arena = arena_;}
+	// builds the IBFS graph for the same volume as setvolume(): voxels outside box are background,
+	// voxels inside are ballooned, with Potts weight weight_potts and color separation weight
+	// boxsize/l1overlap*beta_prime as in OneCut. Throws std::length_error past the size limits above
+	void constructgraph(const Table3D<float> & vol, const Cuboid & box, float weight_potts, float beta_prime = 0.9);
+	// computes the cut and streams the labeling into mask in node order, returns the number of OBJ voxels
+	int run(unsigned char * mask, unsigned char objvalue = 1, unsigned char bkgvalue = 0);
+	int run(Table3D<unsigned char> & mask, unsigned char objvalue = 1, unsigned char bkgvalue = 0);
+	double getflow() const {return flow;}
+	int getnumbins() const {return numbins;}
+	int getboxsize() const {return boxsize;}
+
+	void print();
+private:
+	int vol_w, vol_h, vol_d;
+	int connectivity; // 6, 18 or 26
+	double binsize;
+	int numbins;
+	vector<unsigned short> binning; // intensity bin of every voxel, in node order
+	double sigma_square; // mean dI over all pairs of neighbors
+	int boxsize;
+	double flow;
+	IBFSGraph * ibfsgraph;
+	MemArena * arena;
+
+	template<int C> void computesigma(const Table3D<float> & vol);
+	template<int C> void constructgraph(const Table3D<float> & vol, const Cuboid & box, float weight_potts, float beta_prime);
+	void releasegraph();
+};
+
+inline OneCut3D::OneCut3D():vol_w(0),vol_h(0),vol_d(0),numbins(0),boxsize(0),flow(0),ibfsgraph(NULL),arena(NULL)
+{
+}
+
+inline OneCut3D::OneCut3D(const Table3D<float> & vol, double binsize_, int connectivity_)
+	:numbins(0),boxsize(0),flow(0),ibfsgraph(NULL),arena(NULL)
+{
+	setvolume(vol, binsize_, connectivity_);
+}
+
+inline OneCut3D::~OneCut3D(){
+	releasegraph();
+}
+
+inline void OneCut3D::releasegraph(){
+	if(ibfsgraph!=NULL){
+		if(arena!=NULL) ibfsgraph->~IBFSGraph();
+		else delete ibfsgraph;
+		ibfsgraph = NULL;
+	}
+}
+
+inline void OneCut3D::setvolume(const Table3D<float> & vol, double binsize_, int connectivity_)
+{
+	Assert((connectivity_==6)||(connectivity_==18)||(connectivity_==26), "volume connectivity can only be 6, 18 or 26!");
+	Assert(binsize_>0, "bin size must be positive");
+	releasegraph();
+	vol_w = vol.getWidth();
+	vol_h = vol.getHeight();
+	vol_d = vol.getDepth();
+	connectivity = connectivity_;
+	binsize = binsize_;
+
+	// bins of binsize counted from 0, as the color bins of OneCut, then numbered by the occupied ones
+	const size_t n = vol.getSize();
+	const float * v = vol.data();
+	long long first = (long long)floor(vol.getMin()/binsize), last = (long long)floor(vol.getMax()/binsize);
+	Assert(last-first < (1<<24), "too many intensity bins, increase the bin size");
+	vector<int> rank(last-first+1,0);
+	for(size_t i=0;i<n;i++) rank[(long long)floor(v[i]/binsize)-first] = 1;
+	numbins = 0;
+	for(size_t b=0;b<rank.size();b++) rank[b] = rank[b] ? numbins++ : -1;
+	Assert(numbins <= 65536, "more than 65536 occupied intensity bins, increase the bin size");
+	binning.resize(n);
+	for(size_t i=0;i<n;i++) binning[i] = (unsigned short)rank[(long long)floor(v[i]/binsize)-first];
+
+	if(connectivity==6) computesigma<6>(vol);
+	else if(connectivity==18) computesigma<18>(vol);
+	else computesigma<26>(vol);
+}
+
+template<int C>
+void OneCut3D::computesigma(const Table3D<float> & vol)
+{
+	const float * v = vol.data();
+	double sigma_sum = 0, sigma_count = 0;
+	for(int z=0;z<vol_d;z++)
+		forvolumeneighbors<C>(vol_w, vol_h, vol_d, z, [&](int p, int q, int i){
+			double d = (double)v[p]-v[q];
+			sigma_sum += d*d;
+			sigma_count ++;
+		});
+	sigma_square = (sigma_count>0) ? sigma_sum/sigma_count : 1;
+	if(sigma_square<=0) sigma_square = 1; // constant volume
+}
+
+inline void OneCut3D::constructgraph(const Table3D<float> & vol, const Cuboid & box, float weight_potts, float beta_prime)
+{
+	Assert(((int)vol.getWidth()==vol_w)&&((int)vol.getHeight()==vol_h)&&((int)vol.getDepth()==vol_d), "volume must be the one given to setvolume()");
+	if(connectivity==6) constructgraph<6>(vol, box, weight_potts, beta_prime);
+	else if(connectivity==18) constructgraph<18>(vol, box, weight_potts, beta_prime);
+	else constructgraph<26>(vol, box, weight_potts, beta_prime);
+}
+
+template<int C>
+void OneCut3D::constructgraph(const Table3D<float> & vol, const Cuboid & box, float weight_potts, float beta_prime)
+{
+	releasegraph();
+	const long long slicesize = (long long)vol_w*vol_h;
+	const int numvoxels = (int)(slicesize*vol_d);
+
+	// histograms inside and outside of the box
+	vector<int> obj_hist(numbins,0), bkg_hist(numbins,0);
+	boxsize = 0;
+	for(int z=0;z<vol_d;z++)
+		for(int y=0;y<vol_h;y++)
+		{
+			const unsigned short * bin_row = &binning[y*vol_w+z*slicesize];
+			for(int x=0;x<vol_w;x++)
+				if(box.contains(x,y,z)){ obj_hist[bin_row[x]]++; boxsize++; }
+				else bkg_hist[bin_row[x]]++;
+		}
+	int l1overlap = 0;
+	for(int b=0;b<numbins;b++) l1overlap += min(obj_hist[b],bkg_hist[b]);
+	float l1penalty = max(l1overlap,1);
+	float separation_w = (float)boxsize/l1penalty*beta_prime; // as OneCut::colorseparationweight()
+	int separation = (int)(separation_w*FLOATTOINTSCALE);
+
+	// exact number of edges: n-links of every shift and one color separation arc per voxel
+	long long numedges = numvoxels;
+	for(int i=0;i<VolumeShifts<C>::count;i++)
+		numedges += (long long)(vol_w-abs(volumeshiftx[i]))*(vol_h-abs(volumeshifty[i]))*(vol_d-volumeshiftz[i]);
+	if(numedges >= INT_MAX || (long long)numvoxels+numbins >= INT_MAX)
+		throw std::length_error("volume too large for the int node and edge counts of IBFS");
+	void * mem = (arena!=NULL) ? arena->alloc(sizeof(IBFSGraph)) : ::operator new(sizeof(IBFSGraph));
+	ibfsgraph = new (mem) IBFSGraph(IBFSGraph::IB_INIT_DIRECT, arena);
+	ibfsgraph->initSize(numvoxels+numbins,(int)numedges);
+
+	// degrees: every n-link counts at both voxels, every voxel has one arc to its bin
+	for(int z=0;z<vol_d;z++)
+		forvolumeneighbors<C>(vol_w, vol_h, vol_d, z, [&](int p, int q, int i){
+			ibfsgraph->addDegree(p,1);
+			ibfsgraph->addDegree(q,1);
+		});
+	for(int p=0;p<numvoxels;p++) ibfsgraph->addDegree(p,1);
+	for(int b=0;b<numbins;b++) ibfsgraph->addDegree(numvoxels+b,obj_hist[b]+bkg_hist[b]);
+	ibfsgraph->initArcs();
+
+	double norm[VolumeShifts<C>::count];
+	for(int i=0;i<VolumeShifts<C>::count;i++)
+		norm[i] = Vect3D(volumeshiftx[i],volumeshifty[i],volumeshiftz[i]).norm();
+	const float * v = vol.data();
+	for(int z=0;z<vol_d;z++) // slice by slice: t-links, color separation arcs, n-links to this and the next slice
+	{
+		for(int y=0;y<vol_h;y++)
+		{
+			int p = (int)(y*vol_w+z*slicesize);
+			for(int x=0;x<vol_w;x++,p++)
+			{
+				if(box.contains(x,y,z))
+					ibfsgraph->addNode(p,1*FLOATTOINTSCALE,0); // linear foreground ballooning inside the box
+				else
+					ibfsgraph->addNode(p,0,INT_MAX); // hard constraint outside the box, as IBFSSolver::hard()
+				ibfsgraph->addEdge(p,numvoxels+binning[p],separation,separation);
+			}
+		}
+		forvolumeneighbors<C>(vol_w, vol_h, vol_d, z, [&](int p, int q, int i){
+			double d = (double)v[p]-v[q];
+			double cap = weight_potts*(Gaussian(d*d,1.0,sigma_square)/norm[i]); // as addsmoothnessterm()
+			ibfsgraph->addEdge(p,q,(int)(cap*FLOATTOINTSCALE),(int)(cap*FLOATTOINTSCALE));
+		});
+	}
+}
+
+inline int OneCut3D::run(unsigned char * mask, unsigned char objvalue, unsigned char bkgvalue){
+	ibfsgraph->initGraph();
+	ibfsgraph->computeMaxFlow();
+	flow = ibfsgraph->getFlow();
+	return ibfsgraph->getNodeSides(mask, 0, vol_w*vol_h*vol_d, true, objvalue, bkgvalue);
+}
+
+inline int OneCut3D::run(Table3D<unsigned char> & mask, unsigned char objvalue, unsigned char bkgvalue){
+	mask.resize(vol_w,vol_h,vol_d);
+	return run(mask.data(),objvalue,bkgvalue);
+}
+
+inline void OneCut3D::print()
+{
+	cout<<"Volume: "<<vol_w<<" x "<<vol_h<<" x "<<vol_d<<endl;
+	cout<<"Intensity bin size: "<<binsize<<endl;
+	cout<<"number of non-empty intensity bins: "<<numbins<<endl;
+}
@@ -0,0 +1,138 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <sstream>
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Client side of the protocol of server.cpp over its unix socket: one request header line (and payload) out,
+// one response header line (and "bytes" bytes of payload) back. Used by the client tool and by ./check.
+//
+//		ServerClient client;
+//		client.connect("/tmp/onecut.sock");
+//		ServerClient::Header response;
+//		std::vector<unsigned char> mask;
+//		client.request("cmd=segment id=1 image=images/326038.bmp box=163,20,360,315", response, mask);
+//		if (response["status"] == "ok") ... mask has response["width"] x response["height"] bytes ...
+class ServerClient
+{
+public:
+	typedef std::map<std::string,std::string> Header;
+
+	ServerClient() : m_fd(-1), m_begin(0), m_end(0) {}
+	~ServerClient() {close();}
+
+	bool connect(const char * socketpath)
+	{
+		close();
+		m_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (m_fd < 0) return false;
+		sockaddr_un addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		strncpy(addr.sun_path, socketpath, sizeof(addr.sun_path)-1);
+		if (::connect(m_fd, (sockaddr*)&addr, sizeof(addr)) != 0) {close(); return false;}
+		return true;
+	}
+	void close()
+	{
+		if (m_fd >= 0) ::close(m_fd);
+		m_fd = -1;
+		m_begin = m_end = 0;
+	}
+	bool isConnected() const {return m_fd >= 0;}
+
+	// sends line (without the newline) and the payload, whose size must be given as bytes= in line
+	bool send(const std::string & line, const std::vector<unsigned char> & payload = std::vector<unsigned char>())
+	{
+		std::string header = line + "\n";
+		return writeAll(header.data(), header.size()) && (payload.empty() || writeAll((const char*)&payload[0], payload.size()));
+	}
+	// reads one response, false if the server closed the connection
+	bool receive(Header & response, std::vector<unsigned char> & payload)
+	{
+		if (!readLine(m_line)) return false;
+		response = parse(m_line);
+		payload.resize(atol(response["bytes"].c_str()));
+		return payload.empty() || readBytes((char*)&payload[0], payload.size());
+	}
+	bool request(const std::string & line, Header & response, std::vector<unsigned char> & payload)
+	{
+		return send(line) && receive(response, payload);
+	}
+	// header line of the last response as received
+	const std::string & getLine() const {return m_line;}
+
+	static Header parse(const std::string & line)
+	{
+		Header h;
+		std::istringstream in(line);
+		std::string token;
+		while (in >> token) {
+			size_t eq = token.find('=');
+			if (eq == std::string::npos) h[token] = "";
+			else h[token.substr(0,eq)] = token.substr(eq+1);
+		}
+		return h;
+	}
+
+private:
+	int m_fd;
+	std::string m_line;
+	char m_buffer[1<<16];
+	size_t m_begin, m_end;
+
+	bool fill()
+	{
+		if (m_begin == m_end) m_begin = m_end = 0;
+		ssize_t n;
+		do n = read(m_fd, m_buffer+m_end, sizeof(m_buffer)-m_end); while (n < 0 && errno == EINTR);
+		if (n <= 0) return false;
+		m_end += n;
+		return true;
+	}
+	bool readLine(std::string & line)
+	{
+		line.clear();
+		while (true) {
+			char * nl = (char*)memchr(m_buffer+m_begin, '\n', m_end-m_begin);
+			if (nl) {
+				line.append(m_buffer+m_begin, nl);
+				m_begin = nl-m_buffer+1;
+				return true;
+			}
+			line.append(m_buffer+m_begin, m_buffer+m_end);
+			m_begin = m_end;
+			if (!fill()) return false;
+		}
+	}
+	bool readBytes(char * data, size_t size)
+	{
+		while (size > 0) {
+			if (m_begin == m_end && !fill()) return false;
+			size_t n = std::min(size, m_end-m_begin);
+			memcpy(data, m_buffer+m_begin, n);
+			m_begin += n; data += n; size -= n;
+		}
+		return true;
+	}
+	bool writeAll(const char * data, size_t size)
+	{
+		if (m_fd < 0) return false;
+		while (size > 0) {
+			ssize_t n = write(m_fd, data, size);
+			if (n < 0) {if (errno == EINTR) continue; return false;}
+			data += n; size -= n;
+		}
+		return true;
+	}
+
+	ServerClient(const ServerClient&);
+	ServerClient& operator=(const ServerClient&);
+};
@@ -0,0 +1,125 @@
+#pragma once
+#include <math.h>
+#include <vector>
+#include "ezi/Table2D.h"
+#include "ezi/Image2D.h"
+
+// SLIC superpixels (Achanta et al. 2012) in RGB, seeded on a regular grid.
+//
+//		SuperPixels sp;
+//		sp.compute(image, 16);                 // superpixels of about 16x16 pixels
+//		int k = sp.getLabels()[x][y];          // superpixel of pixel (x,y), 0 <= k < sp.getNumSuperPixels()
+//
+// Every pixel looks for its center among the seeds of the 3x3 surrounding grid cells, so the assignment
+// step runs in parallel over columns without write conflicts. Superpixels are 4-connected: fragments
+// smaller than a quarter of a grid cell are merged into a neighboring superpixel.
+class SuperPixels
+{
+public:
+	SuperPixels() : m_num(0) {}
+	// size: spacing of the seed grid in pixels, compactness: weight of the spatial distance
+	// (a color distance of compactness weighs as much as a distance of size pixels)
+	void compute(const Table2DView<RGB> & img, int size, double compactness = 10, int iterations = 10);
+
+	int getNumSuperPixels() const {return m_num;}
+	const Table2D<int> & getLabels() const {return m_labels;}
+	int getSize() const {return m_size;}
+
+private:
+	struct Center {double r, g, b, x, y;};
+	int m_num, m_size;
+	Table2D<int> m_labels;
+	std::vector<Center> m_centers;
+	std::vector<int> m_stack; // flood fill of the connectivity pass
+};
+
+inline void SuperPixels::compute(const Table2DView<RGB> & img, int size, double compactness, int iterations)
+{
+	const int w = img.getWidth(), h = img.getHeight();
+	m_size = size = std::max(size, 1);
+	const int gw = (w+size-1)/size, gh = (h+size-1)/size;
+	// seed of grid cell (i,j) is center i+j*gw
+	m_centers.resize(gw*gh);
+	for (int j=0; j<gh; j++)
+		for (int i=0; i<gw; i++) {
+			int x = std::min(i*size+size/2, w-1), y = std::min(j*size+size/2, h-1);
+			RGB c = img[x][y];
+			Center center = {(double)c.r, (double)c.g, (double)c.b, (double)x, (double)y};
+			m_centers[i+j*gw] = center;
+		}
+	m_labels.resize(w, h);
+	const double spatial = (compactness*compactness)/((double)size*size);
+
+	std::vector<double> sums;
+	for (int it=0; it<iterations; it++) {
+		// assignment: nearest center of the 3x3 grid cells around the pixel
+		#pragma omp parallel for schedule(static)
+		for (int x=0; x<w; x++) {
+			RGB * img_col = img[x];
+			int * label_col = m_labels[x];
+			int gi = x/size;
+			for (int y=0; y<h; y++) {
+				int gj = y/size;
+				double best = 1e300;
+				int bestk = gi+gj*gw;
+				for (int j=std::max(gj-1,0); j<=std::min(gj+1,gh-1); j++)
+					for (int i=std::max(gi-1,0); i<=std::min(gi+1,gw-1); i++) {
+						const Center & c = m_centers[i+j*gw];
+						double dr = img_col[y].r-c.r, dg = img_col[y].g-c.g, db = img_col[y].b-c.b;
+						double dx = x-c.x, dy = y-c.y;
+						double d = dr*dr+dg*dg+db*db+spatial*(dx*dx+dy*dy);
+						if (d < best) {best = d; bestk = i+j*gw;}
+					}
+				label_col[y] = bestk;
+			}
+		}
+		// update: centers move to the mean color and position of their pixels
+		sums.assign(6*m_centers.size(), 0);
+		for (int x=0; x<w; x++) {
+			RGB * img_col = img[x];
+			int * label_col = m_labels[x];
+			for (int y=0; y<h; y++) {
+				double * s = &sums[6*label_col[y]];
+				s[0] += img_col[y].r; s[1] += img_col[y].g; s[2] += img_col[y].b;
+				s[3] += x; s[4] += y; s[5] += 1;
+			}
+		}
+		for (size_t k=0; k<m_centers.size(); k++) {
+			const double * s = &sums[6*k];
+			if (s[5] == 0) continue; // keeps its position, no pixel chose it
+			Center c = {s[0]/s[5], s[1]/s[5], s[2]/s[5], s[3]/s[5], s[4]/s[5]};
+			m_centers[k] = c;
+		}
+	}
+
+	// connectivity: every 4-connected component becomes a superpixel, small ones join the previous neighbor
+	Table2D<int> labels(w, h, -1);
+	const int minsize = std::max(size*size/4, 1);
+	m_num = 0;
+	for (int y=0; y<h; y++)
+		for (int x=0; x<w; x++) {
+			if (labels[x][y] >= 0) continue;
+			const int old = m_labels[x][y];
+			int adjacent = -1; // label of an already relabeled 4-neighbor
+			if (x > 0) adjacent = labels[x-1][y];
+			else if (y > 0) adjacent = labels[x][y-1];
+			m_stack.clear();
+			m_stack.push_back(x+y*w);
+			labels[x][y] = m_num;
+			for (size_t s=0; s<m_stack.size(); s++) {
+				int px = m_stack[s]%w, py = m_stack[s]/w;
+				const int nx[4] = {px-1, px+1, px, px}, ny[4] = {py, py, py-1, py+1};
+				for (int n=0; n<4; n++)
+					if (img.pointIn(nx[n], ny[n]) && labels[nx[n]][ny[n]] < 0 && m_labels[nx[n]][ny[n]] == old) {
+						labels[nx[n]][ny[n]] = m_num;
+						m_stack.push_back(nx[n]+ny[n]*w);
+					}
+			}
+			if ((int)m_stack.size() < minsize && adjacent >= 0) {
+				for (size_t s=0; s<m_stack.size(); s++) labels[m_stack[s]%w][m_stack[s]/w] = adjacent;
+				continue;
+			}
+			m_num++;
+		}
+	m_labels = std::move(labels);
+}
@@ -0,0 +1,365 @@
+#pragma once
+#include "OneCut.h"
+#include "MappedPNM.h"
+
+// Out-of-core OneCut for images that do not fit in RAM, e.g. gigapixel slides. The image is a memory mapped
+// P6 file and the result a memory mapped P5 mask (255 = object), only one window of the graph is built at a time.
+//
+// The energy is the one of OneCut with a rectangular box: same bins, contrast weights (sigma over the whole
+// image) and color separation weight. It is minimized by block coordinate descent on the current mask,
+// which starts as the box: each window is solved exactly with all pixels outside of it fixed to their
+// current labels, their n-links folded into t-links of the window pixels and their color separation arcs
+// into t-links of the bins (by global per-bin counts of OBJ and BKG pixels). Sweeps over the tiles are
+// followed by sweeps over tiles shifted by a half, a quarter and three quarters of a tile, whose windows
+// straddle the previous seams, until a sweep changes no pixel or after maxrefinements of them. The energy
+// never increases from one window to the next but may stop in a local minimum above the one of OneCut, the
+// smaller the tiles the more likely.
+//
+// The mask is therefore not exact, but certified: a last sweep computes a lower bound on the energy of
+// OneCut from independent tiles. Each tile is solved exactly without the n-links to other tiles, with
+// the BKG pixels outside of the box shared among the tiles in proportion to their pixels of every bin,
+// since min(sum a, sum b) >= sum min(a, b) for the color separation term. getEnergy()-getLowerBound()
+// bounds how far the mask is from the optimum, 0 when one tile covers the box.
+//
+//		MappedPNM image, mask;
+//		image.open("slide.ppm");
+//		mask.create("mask.pgm", image.getWidth(), image.getHeight(), 1);
+//		MemArena arena(0, "/scratch/graph.bin");               // graphs paged to a file if needed
+//		TiledCut tiled(TiledCut::tileSizeForBudget(512<<20));    // tiles for 512 MB of graph memory
+//		tiled.setArena(&arena);
+//		tiled.run(image, x1, y1, x2, y2, mask);
+class TiledCut
+{
+public:
+	TiledCut(int tileSize = 1024, int binSize = 8, int connectivity = 8,
+		float weightPotts = 9.0, float betaPrime = 0.9);
+
+	// graphs of the windows are drawn from arena (reset before every window), from the heap if NULL
+	void setArena(MemArena * arena_) {arena = arena_;}
+	void setMaxRefinements(int n) {maxrefinements = n;}
+	// segments image with the box [x1,x2]x[y1,y2] (inclusive) into mask, a mapping of the same size. Returns
+	// the energy of the mask in the units of OneCut::getflow() with IBFS, -1 if the box is outside of the
+	// image or the mappings do not match. getLowerBound() is then at most the energy of OneCut.
+	double run(const MappedPNM & image, int x1, int y1, int x2, int y2, MappedPNM & mask);
+
+	// largest tile whose graph fits in a memory budget
+	static int tileSizeForBudget(size_t bytes, int connectivity = 8);
+
+	// statistics of the last run
+	int getNumWindows() const {return numwindows;}
+	int getNumRefinements() const {return numrefinements;} // sweeps after the first one
+	long long getRefinedPixels() const {return refinedpixels;} // pixels changed by them
+	double getEnergy() const {return energy;} // energy of the final mask, as returned by run()
+	double getLowerBound() const {return lowerbound;} // no mask has a lower energy
+	double getSigmaSquare() const {return sigma_square;}
+
+private:
+	int tilesize, binsize, connectivity, maxrefinements;
+	float weight_potts, beta_prime;
+	MemArena * arena;
+
+	// state of a run
+	const MappedPNM * image;
+	MappedPNM * mask;
+	int img_w, img_h, bx1, by1, bx2, by2;
+	int binperchannel;
+	double sigma_square;
+	int separation; // integer capacity of a color separation arc
+	vector<long long> globalobj, globalbkg; // pixels of every bin labeled OBJ / BKG in the mask
+	vector<long long> boxhist, outhist; // pixels of every bin inside / outside of the box
+	int numwindows, numrefinements;
+	long long refinedpixels;
+	double energy, lowerbound;
+
+	// scratch space of a window, kept to avoid reallocation
+	vector<RGB> crop;
+	vector<int> hubof, hubbin;
+	vector<long long> windowobj, windowbkg, capsource, capsink;
+
+	int bin(const RGB & c) const {return c.r/binsize+(c.g/binsize)*binperchannel+(c.b/binsize)*binperchannel*binperchannel;}
+	RGB pixel(int x, int y) const {const unsigned char * p = image->row(y)+3*x; return RGB(p[0],p[1],p[2]);}
+	bool inbox(int x, int y) const {return (x>=bx1)&&(x<=bx2)&&(y>=by1)&&(y<=by2);}
+	static const int evictrows = 256; // streaming passes drop the pages behind them in blocks of rows
+	template<int C> void computestatistics();
+	// energy of the current mask: one streaming pass for the n-links, ballooning and color separation
+	// from the global bin counts
+	double computeenergy();
+	template<int C> long long computeenergy();
+	// solves the window [wx1,wx2)x[wy1,wy2) inside the box, returns the number of changed pixels. With bound
+	// the window is solved as a tile of the lower bound instead, its min cut is added to lowerbound and the
+	// mask is left as it is
+	long long solvewindow(int wx1, int wy1, int wx2, int wy2, bool bound);
+	// solves the tiles of the grid shifted by offset, returns the number of changed pixels
+	long long sweep(int offset, bool bound = false);
+	template<int C> long long solvewindow(int wx1, int wy1, int wx2, int wy2, bool bound);
+};
+
+inline TiledCut::TiledCut(int tileSize, int binSize, int connectivity_, float weightPotts, float betaPrime)
+	:tilesize(tileSize), binsize(binSize), connectivity(connectivity_), maxrefinements(8),
+	weight_potts(weightPotts), beta_prime(betaPrime), arena(NULL), image(NULL), mask(NULL),
+	numwindows(0), numrefinements(0), refinedpixels(0), energy(0), lowerbound(0)
+{
+	Assert((connectivity==4)||(connectivity==8)||(connectivity==16), "grid connectivity can only be 4, 8 or 16!");
+	Assert(tilesize>=2 && binsize>=1 && binsize<=256, "invalid tile size or bin size");
+}
+
+inline int TiledCut::tileSizeForBudget(size_t bytes, int connectivity)
+{
+	// IBFS nodes and arcs per window pixel as measured with IB_INIT_FAST, plus the crop and t-links
+	double perpixel = 136+32.0*connectivity;
+	return std::max((int)sqrt(bytes/perpixel), 64);
+}
+
+template<int C>
+void TiledCut::computestatistics()
+{
+	// contrast over all pairs of neighbors, in the order of OneCut::computeedges()
+	double sigma_sum = 0, sigma_count = 0;
+	int evicted = 0; // rows before it are not resident anymore
+	forgridneighbors<C>(img_w, img_h, [&](Point p, Point q, int i){
+		if (p.y-evicted>=evictrows+2) {image->evictRows(evicted,p.y-2); evicted = p.y-2;}
+		sigma_sum += dI(pixel(p.x,p.y),pixel(q.x,q.y));
+		sigma_count ++;
+	});
+	sigma_square = sigma_sum/sigma_count;
+}
+
+inline double TiledCut::computeenergy()
+{
+	if (connectivity==4) return (double)computeenergy<4>();
+	if (connectivity==8) return (double)computeenergy<8>();
+	return (double)computeenergy<16>();
+}
+
+template<int C>
+long long TiledCut::computeenergy()
+{
+	// the terms of the window graphs: cut n-links, ballooning of the BKG pixels of the box and the cheaper
+	// side of every bin
+	double norm[GridShifts<C>::count];
+	for (int i=0;i<GridShifts<C>::count;i++)
+		norm[i] = Point(gridshiftx[i],gridshifty[i]).norm();
+	long long e = 0;
+	int evicted = 0;
+	forgridneighbors<C>(img_w, img_h, [&](Point p, Point q, int i){
+		if (p.y-evicted>=evictrows+2) {
+			image->evictRows(evicted,p.y-2);
+			mask->evictRows(evicted,p.y-2);
+			evicted = p.y-2;
+		}
+		if ((mask->row(p.y)[p.x]!=0)==(mask->row(q.y)[q.x]!=0)) return;
+		double edgeweight = Gaussian(dI(pixel(p.x,p.y),pixel(q.x,q.y)),1.0,sigma_square)/norm[i];
+		e += (int)(weight_potts*edgeweight*FLOATTOINTSCALE);
+	});
+	for (int y=by1;y<=by2;y++)
+	{
+		const unsigned char * mask_row = mask->row(y);
+		for (int x=bx1;x<=bx2;x++)
+			if (mask_row[x]==0) e += FLOATTOINTSCALE;
+	}
+	for (size_t b=0;b<globalobj.size();b++)
+		e += (long long)separation*min(globalobj[b],globalbkg[b]);
+	return e;
+}
+
+inline double TiledCut::run(const MappedPNM & image_, int x1, int y1, int x2, int y2, MappedPNM & mask_)
+{
+	image = &image_;
+	mask = &mask_;
+	img_w = image->getWidth();
+	img_h = image->getHeight();
+	if (image->getChannels()!=3 || mask->getChannels()!=1 || mask->getWidth()!=img_w || mask->getHeight()!=img_h)
+		return -1;
+	bx1 = max(x1,0); by1 = max(y1,0); bx2 = min(x2,img_w-1); by2 = min(y2,img_h-1);
+	if (bx1>bx2 || by1>by2) return -1;
+	binperchannel = (int)ceil(256.0/binsize);
+	const int numbins = binperchannel*binperchannel*binperchannel;
+
+	// one streaming pass: histograms inside and outside the box, the initial mask, then the contrast
+	image->adviseSequential();
+	vector<long long> obj_hist(numbins,0), bkg_hist(numbins,0);
+	long long boxsize = 0;
+	for (int y=0;y<img_h;y++)
+	{
+		unsigned char * mask_row = mask->row(y);
+		for (int x=0;x<img_w;x++)
+		{
+			bool in = inbox(x,y);
+			(in ? obj_hist : bkg_hist)[bin(pixel(x,y))]++;
+			mask_row[x] = in ? 255 : 0;
+			boxsize += in;
+		}
+		if ((y+1)%evictrows==0) {
+			image->evictRows(y+1-evictrows,y+1);
+			mask->evictRows(y+1-evictrows,y+1);
+		}
+	}
+	if (connectivity==4) computestatistics<4>();
+	else if (connectivity==8) computestatistics<8>();
+	else computestatistics<16>();
+	image->adviseRandom();
+	long long l1overlap = 0;
+	for (int b=0;b<numbins;b++) l1overlap += min(obj_hist[b],bkg_hist[b]);
+	float separation_w = (float)boxsize/(float)max(l1overlap,1LL)*beta_prime; // as OneCut::colorseparationweight()
+	separation = (int)(separation_w*FLOATTOINTSCALE);
+	globalobj = boxhist = obj_hist;
+	globalbkg = outhist = bkg_hist;
+	hubof.assign(numbins,-1);
+
+	numwindows = 0;
+	numrefinements = 0;
+	refinedpixels = 0;
+	// the tiles, then tiles shifted by a half, a quarter and three quarters of a tile: the seams of the first
+	// two grids run through the middle of the windows of the last two, until a sweep changes nothing
+	const int offsets[4] = {tilesize/2, tilesize/4, 3*tilesize/4, 0};
+	sweep(0);
+	while (numrefinements<maxrefinements)
+	{
+		long long changed = sweep(offsets[numrefinements%4]);
+		numrefinements++;
+		refinedpixels += changed;
+		if (changed==0) break;
+	}
+	lowerbound = 0;
+	sweep(0,true);
+	image->adviseSequential();
+	energy = computeenergy();
+	image->adviseRandom();
+	return energy;
+}
+
+inline long long TiledCut::sweep(int offset, bool bound)
+{
+	// a row of tiles at a time: the next row is prefetched, the finished one evicted
+	long long changed = 0;
+	for (int ty=by1-offset; ty<=by2; ty+=tilesize)
+	{
+		int ty1 = max(ty,by1), ty2 = min(ty+tilesize,by2+1);
+		image->prefetchRows(max(ty2-2,0),min(ty2+tilesize+2,img_h));
+		for (int tx=bx1-offset; tx<=bx2; tx+=tilesize)
+			changed += solvewindow(max(tx,bx1),ty1,min(tx+tilesize,bx2+1),ty2,bound);
+		image->evictRows(max(ty1-2,0),max(ty2-2,0));
+		mask->evictRows(max(ty1-2,0),max(ty2-2,0));
+	}
+	return changed;
+}
+
+inline long long TiledCut::solvewindow(int wx1, int wy1, int wx2, int wy2, bool bound)
+{
+	if (connectivity==4) return solvewindow<4>(wx1,wy1,wx2,wy2,bound);
+	if (connectivity==8) return solvewindow<8>(wx1,wy1,wx2,wy2,bound);
+	return solvewindow<16>(wx1,wy1,wx2,wy2,bound);
+}
+
+template<int C>
+long long TiledCut::solvewindow(int wx1, int wy1, int wx2, int wy2, bool bound)
+{
+	numwindows++;
+	const int ww = wx2-wx1, wh = wy2-wy1, numvars = ww*wh;
+	// the window with a halo of the longest shift, neighbors of window pixels are inside of it
+	const int cx1 = max(wx1-2,0), cy1 = max(wy1-2,0), cx2 = min(wx2+2,img_w), cy2 = min(wy2+2,img_h);
+	const int cw = cx2-cx1, ch = cy2-cy1;
+	crop.resize((size_t)cw*ch);
+	for (int y=cy1;y<cy2;y++)
+		for (int x=cx1;x<cx2;x++)
+			crop[(x-cx1)+(y-cy1)*cw] = pixel(x,y);
+
+	// bins of the window pixels are its hubs
+	hubbin.clear();
+	windowobj.clear();
+	windowbkg.clear();
+	for (int y=wy1;y<wy2;y++)
+	{
+		const unsigned char * mask_row = mask->row(y);
+		for (int x=wx1;x<wx2;x++)
+		{
+			int b = bin(crop[(x-cx1)+(y-cy1)*cw]);
+			if (hubof[b]<0) {
+				hubof[b] = hubbin.size();
+				hubbin.push_back(b);
+				windowobj.push_back(0);
+				windowbkg.push_back(0);
+			}
+			(mask_row[x] ? windowobj : windowbkg)[hubof[b]]++;
+		}
+	}
+	const int numhubs = hubbin.size();
+
+	if (arena!=NULL) arena->reset();
+	IBFSGraph g(IBFSGraph::IB_INIT_FAST, arena);
+	g.initSize(numvars+numhubs, numvars*(C/2+1));
+	capsource.assign(numvars+numhubs,0);
+	capsink.assign(numvars+numhubs,0);
+	for (int i=0;i<numvars;i++) capsource[i] = FLOATTOINTSCALE; // ballooning, the window is inside the box
+
+	double norm[GridShifts<C>::count];
+	for (int i=0;i<GridShifts<C>::count;i++)
+		norm[i] = Point(gridshiftx[i],gridshifty[i]).norm();
+	forgridneighbors<C>(cw, ch, [&](Point p, Point q, int i){
+		int px = p.x+cx1, py = p.y+cy1, qx = q.x+cx1, qy = q.y+cy1;
+		bool pin = (px>=wx1)&&(px<wx2)&&(py>=wy1)&&(py<wy2), qin = (qx>=wx1)&&(qx<wx2)&&(qy>=wy1)&&(qy<wy2);
+		if (!pin&&!qin) return;
+		double edgeweight = Gaussian(dI(crop[p.x+p.y*cw],crop[q.x+q.y*cw]),1.0,sigma_square)/norm[i];
+		double v = weight_potts*edgeweight; // as OneCut::addsmoothnessterm()
+		int cap = (int)(v*FLOATTOINTSCALE);
+		int lp = (px-wx1)+(py-wy1)*ww, lq = (qx-wx1)+(qy-wy1)*ww;
+		if (pin&&qin) g.addEdge(lp,lq,cap,cap);
+		else if (bound) { // the n-links to other tiles are dropped, pixels outside of the box are BKG
+			if (pin&&!inbox(qx,qy)) capsink[lp] += cap;
+			else if (qin&&!inbox(px,py)) capsink[lq] += cap;
+		}
+		else if (pin) (mask->row(qy)[qx] ? capsource : capsink)[lp] += cap;
+		else (mask->row(py)[px] ? capsource : capsink)[lq] += cap;
+	});
+	for (int y=wy1;y<wy2;y++)
+		for (int x=wx1;x<wx2;x++)
+		{
+			int hub = numvars+hubof[bin(crop[(x-cx1)+(y-cy1)*cw])];
+			g.addEdge((x-wx1)+(y-wy1)*ww,hub,separation,separation);
+		}
+	for (int h=0;h<numhubs;h++)
+	{
+		int b = hubbin[h];
+		if (bound) // the share of the tile of the pixels outside of the box, rounded down
+			capsink[numvars+h] += (long long)((double)separation*outhist[b]*(windowobj[h]+windowbkg[h])/boxhist[b]);
+		else { // the color separation arcs of all pixels outside the window
+			capsource[numvars+h] += (long long)separation*(globalobj[b]-windowobj[h]);
+			capsink[numvars+h] += (long long)separation*(globalbkg[b]-windowbkg[h]);
+		}
+	}
+	long long offset = 0;
+	for (int i=0;i<numvars+numhubs;i++)
+	{
+		// only the difference matters, clipped to the int capacities as in PartitionedCut. Clipping only
+		// lowers the min cut, so the lower bound stays one
+		offset += min(capsource[i],capsink[i]);
+		long long net = max(min(capsource[i]-capsink[i],(long long)INT_MAX),-(long long)INT_MAX);
+		g.addNode(i,net>0 ? (int)net : 0,net<0 ? (int)-net : 0);
+	}
+	if (arena!=NULL) arena->prefetch();
+	g.initGraph();
+	g.computeMaxFlow(true);
+	if (bound) {
+		lowerbound += (double)(g.getFlow()+offset);
+		for (int h=0;h<numhubs;h++) hubof[hubbin[h]] = -1;
+		return 0;
+	}
+
+	long long changed = 0;
+	for (int y=wy1;y<wy2;y++)
+	{
+		unsigned char * mask_row = mask->row(y);
+		for (int x=wx1;x<wx2;x++)
+		{
+			unsigned char label = g.isNodeOnSrcSide((x-wx1)+(y-wy1)*ww,1) ? 255 : 0;
+			if (label==mask_row[x]) continue;
+			int b = bin(crop[(x-cx1)+(y-cy1)*cw]);
+			if (label) {globalobj[b]++; globalbkg[b]--;}
+			else {globalobj[b]--; globalbkg[b]++;}
+			mask_row[x] = label;
+			changed++;
+		}
+	}
+	for (int h=0;h<numhubs;h++) hubof[hubbin[h]] = -1;
+	return changed;
+}
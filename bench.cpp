@@ -0,0 +1,370 @@
+/***********************************************************************************/
+/*          OneCut - software for interactive image segmentation                   */
+/*          "Grabcut in One Cut"                                                   */
+/*          Meng Tang, Lena Gorelick, Olga Veksler, Yuri Boykov,                   */
+/*          In IEEE International Conference on Computer Vision (ICCV), 2013       */
+/*          https://github.com/meng-tang/OneCut                                    */
+/*          Contact Author: Meng Tang (mtang73@uwo.ca)                             */
+/***********************************************************************************/
+
+// Dataset benchmark: runs OneCut on every item of a folder in the layout of images/
+// (name.bmp, name_box.bmp and optionally name_gt.bmp) and reports latency distributions
+// per phase, peak memory and accuracy.
+//
+// usage: bench folder [--reps n] [--warmup n] [--binsize n] [--connectivity n] [--lambda w]
+//                     [--maxflow ibfs|bk|pr|grid] [--band r] [--json file] [--report file]
+//                     [--binning uniform|mediancut|both] [--bins n]
+//
+// Every item is run warmup times unrecorded, then reps times. One OneCut and one arena are
+// reused over the whole dataset, as in the server. Phases of one run:
+//   load       reading the three BMPs
+//   setimage   color binning and grid edges
+//   construct  box statistics and graph construction
+//   solve      maxflow and labeling
+//   eval       evaluate() against the ground truth
+// Peak RSS is VmHWM after the item, reset before the item through /proc/self/clear_refs.
+// --binning both runs the dataset with uniform bins of binsize and with a median cut palette of at most
+// "bins" bins, and reports both and their difference in latency, number of bins and error rate.
+
+#include "OneCut.h"
+#include "myutil.h"
+#include <iostream>
+#include <chrono>
+#include <dirent.h>
+#include <string.h>
+#include <math.h>
+
+struct BenchConfig
+{
+	BenchConfig():reps(5),warmup(1),binsize(8),connectivity(8),lambda(9.0),maxflowoption(IBFS),bandwidth(2),
+		binningoption(UNIFORMBINS),numbins(1024){}
+	int reps, warmup;
+	int binsize, connectivity;
+	double lambda;
+	MAXFLOW maxflowoption;
+	int bandwidth;
+	BINNING binningoption;
+	int numbins; // MEDIANCUT only
+};
+
+static const char * maxflowname(const BenchConfig & config)
+{
+	switch(config.maxflowoption){
+		case BK: return "bk";
+		case PUSHRELABEL: return "pr";
+		case GRID: return "grid";
+		default: return "ibfs";
+	}
+}
+
+static const char * binningname(const BenchConfig & config)
+{
+	return config.binningoption==MEDIANCUT ? "mediancut" : "uniform";
+}
+
+enum {PHASE_LOAD, PHASE_SETIMAGE, PHASE_CONSTRUCT, PHASE_SOLVE, PHASE_EVAL, PHASE_TOTAL, NUM_PHASES};
+static const char * phasenames[NUM_PHASES] = {"load", "setimage", "construct", "solve", "eval", "total"};
+
+struct BenchItem
+{
+	string name, image, box, gt;
+	int width, height;
+	vector<double> times[NUM_PHASES]; // milliseconds, one per recorded run
+	long peakrss; // kB, -1 if unknown
+	int numcolorbin;
+	bool hasgt;
+	SegEval eval;
+};
+
+static double now()
+{
+	return std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool fileexists(const string & path)
+{
+	FILE * f = fopen(path.c_str(),"rb");
+	if(f) fclose(f);
+	return f!=NULL;
+}
+
+// name.bmp with a name_box.bmp next to it, sorted by name
+static vector<BenchItem> finditems(const string & folder)
+{
+	vector<BenchItem> items;
+	DIR * dir = opendir(folder.c_str());
+	if(dir==NULL) return items;
+	while(dirent * e = readdir(dir)){
+		string file = e->d_name;
+		if(file.size()<5 || file.compare(file.size()-4,4,".bmp")!=0) continue;
+		string name = file.substr(0,file.size()-4);
+		if(name.size()>4 && (name.compare(name.size()-4,4,"_box")==0 || name.compare(name.size()-3,3,"_gt")==0)) continue;
+		if(name.size()>7 && name.compare(name.size()-7,7,"_result")==0) continue;
+		BenchItem item;
+		item.name = name;
+		item.image = folder+"/"+file;
+		item.box = folder+"/"+name+"_box.bmp";
+		item.gt = folder+"/"+name+"_gt.bmp";
+		if(!fileexists(item.box)) continue;
+		item.hasgt = fileexists(item.gt);
+		item.width = item.height = 0;
+		item.peakrss = -1;
+		items.push_back(item);
+	}
+	closedir(dir);
+	std::sort(items.begin(),items.end(),[](const BenchItem & a, const BenchItem & b){return a.name<b.name;});
+	return items;
+}
+
+// resets the peak resident set size of the process (Linux >= 4.0)
+static bool resetpeakrss()
+{
+	FILE * f = fopen("/proc/self/clear_refs","w");
+	if(f==NULL) return false;
+	bool ok = (fputs("5",f)>=0);
+	return (fclose(f)==0) && ok;
+}
+
+static long getpeakrss()
+{
+	FILE * f = fopen("/proc/self/status","r");
+	if(f==NULL) return -1;
+	char line[256];
+	long kb = -1;
+	while(fgets(line,sizeof(line),f))
+		if(strncmp(line,"VmHWM:",6)==0) kb = atol(line+6);
+	fclose(f);
+	return kb;
+}
+
+// nearest rank percentile of sorted values
+static double percentile(const vector<double> & sorted, double p)
+{
+	if(sorted.empty()) return 0;
+	size_t rank = (size_t)ceil(p/100*sorted.size());
+	return sorted[rank>0 ? rank-1 : 0];
+}
+
+static void runitem(BenchItem & item, const BenchConfig & config, OneCut & onecut, MemArena & arena)
+{
+	Table2D<RGB> image;
+	Table2D<int> box, gt;
+	Table2D<Label> segmentation;
+	item.peakrss = resetpeakrss() ? 0 : -1;
+	for(int rep=0;rep<config.warmup+config.reps;rep++){
+		double t[NUM_PHASES+1];
+		t[0] = now();
+		image = loadImage<RGB>(item.image.c_str());
+		box = loadImage<RGB>(item.box.c_str());
+		if(item.hasgt) gt = loadImage<RGB>(item.gt.c_str());
+		t[1] = now();
+		onecut.setarena(NULL);
+		onecut.setimage(image,config.binsize,config.connectivity,config.maxflowoption,config.binningoption,config.numbins);
+		t[2] = now();
+		arena.reset();
+		onecut.setarena(&arena);
+		onecut.setbox(Table2DView<int>(box)); // copied into the reused box of onecut, box is kept for eval
+		onecut.constructbkgraph((float)config.lambda);
+		t[3] = now();
+		onecut.run(segmentation);
+		t[4] = now();
+		if(item.hasgt) item.eval = evaluate(segmentation,gt,box,config.bandwidth);
+		t[5] = now();
+		if(rep<config.warmup) continue;
+		for(int p=0;p<PHASE_TOTAL;p++) item.times[p].push_back(t[p+1]-t[p]);
+		item.times[PHASE_TOTAL].push_back(t[5]-t[0]);
+	}
+	onecut.setarena(NULL);
+	item.width = image.getWidth();
+	item.height = image.getHeight();
+	item.numcolorbin = onecut.getnumcolorbin();
+	if(item.peakrss==0) item.peakrss = getpeakrss();
+}
+
+// mean over all recorded runs of a phase
+static double meantime(const vector<BenchItem> & items, int phase)
+{
+	double sum = 0;
+	size_t n = 0;
+	for(size_t i=0;i<items.size();i++){
+		for(size_t r=0;r<items[i].times[phase].size();r++) sum += items[i].times[phase][r];
+		n += items[i].times[phase].size();
+	}
+	return n ? sum/n : 0;
+}
+
+// mean of the error rate over the items with ground truth, -1 if there are none
+static double meanerrorrate(const vector<BenchItem> & items)
+{
+	double sum = 0;
+	int n = 0;
+	for(size_t i=0;i<items.size();i++)
+		if(items[i].hasgt){ sum += items[i].eval.errorrate; n++; }
+	return n ? sum/n : -1;
+}
+
+static double meancolorbins(const vector<BenchItem> & items)
+{
+	double sum = 0;
+	for(size_t i=0;i<items.size();i++) sum += items[i].numcolorbin;
+	return items.empty() ? 0 : sum/items.size();
+}
+
+static void writereport(FILE * f, const vector<BenchItem> & items, const BenchConfig & config)
+{
+	fprintf(f,"items %d, reps %d, warmup %d, binsize %d, connectivity %d, lambda %g, maxflow %s, binning %s",
+		(int)items.size(),config.reps,config.warmup,config.binsize,config.connectivity,config.lambda,
+		maxflowname(config),binningname(config));
+	if(config.binningoption==MEDIANCUT) fprintf(f," (at most %d bins)",config.numbins);
+	fprintf(f,"\n\n");
+	fprintf(f,"%-10s %10s %10s %10s %10s %10s   (ms over all recorded runs)\n","phase","mean","p50","p95","p99","max");
+	for(int p=0;p<NUM_PHASES;p++){
+		vector<double> all;
+		for(size_t i=0;i<items.size();i++) all.insert(all.end(),items[i].times[p].begin(),items[i].times[p].end());
+		std::sort(all.begin(),all.end());
+		double mean = 0;
+		for(size_t i=0;i<all.size();i++) mean += all[i];
+		if(!all.empty()) mean /= all.size();
+		fprintf(f,"%-10s %10.3f %10.3f %10.3f %10.3f %10.3f\n",phasenames[p],mean,
+			percentile(all,50),percentile(all,95),percentile(all,99),all.empty() ? 0 : all.back());
+	}
+	long maxrss = -1;
+	double errorrate = 0, iou = 0, fmeasure = 0, bandaccuracy = 0;
+	int numgt = 0;
+	for(size_t i=0;i<items.size();i++){
+		maxrss = std::max(maxrss,items[i].peakrss);
+		if(!items[i].hasgt) continue;
+		numgt++;
+		errorrate += items[i].eval.errorrate;
+		iou += items[i].eval.iou;
+		fmeasure += items[i].eval.fmeasure;
+		bandaccuracy += items[i].eval.bandaccuracy;
+	}
+	fprintf(f,"\npeak RSS (max over items): %ld kB\n",maxrss);
+	fprintf(f,"color bins (mean over items): %.1f\n",meancolorbins(items));
+	if(numgt>0)
+		fprintf(f,"accuracy over %d items: error rate %.4f, IoU %.4f, F %.4f, band accuracy %.4f\n",numgt,
+			errorrate/numgt,iou/numgt,fmeasure/numgt,bandaccuracy/numgt);
+}
+
+static void writejson(FILE * f, const vector<BenchItem> & items, const BenchConfig & config)
+{
+	fprintf(f,"{\n  \"config\": {\"reps\": %d, \"warmup\": %d, \"binsize\": %d, \"connectivity\": %d, \"lambda\": %g, \"maxflow\": \"%s\", "
+		"\"binning\": \"%s\", \"bins\": %d},\n",
+		config.reps,config.warmup,config.binsize,config.connectivity,config.lambda,maxflowname(config),
+		binningname(config),config.numbins);
+	fprintf(f,"  \"items\": [\n");
+	for(size_t i=0;i<items.size();i++){
+		const BenchItem & item = items[i];
+		fprintf(f,"    {\"name\": \"%s\", \"width\": %d, \"height\": %d, \"peak_rss_kb\": %ld, \"color_bins\": %d,\n",
+			item.name.c_str(),item.width,item.height,item.peakrss,item.numcolorbin);
+		fprintf(f,"     \"times_ms\": {");
+		for(int p=0;p<NUM_PHASES;p++){
+			fprintf(f,"%s\"%s\": [",p ? ", " : "",phasenames[p]);
+			for(size_t r=0;r<item.times[p].size();r++) fprintf(f,"%s%.4f",r ? ", " : "",item.times[p][r]);
+			fprintf(f,"]");
+		}
+		fprintf(f,"}");
+		if(item.hasgt){
+			const SegEval & e = item.eval;
+			fprintf(f,",\n     \"eval\": {\"tp\": %lld, \"fp\": %lld, \"fn\": %lld, \"tn\": %lld, \"boxsize\": %d, "
+				"\"errorrate\": %.6f, \"iou\": %.6f, \"precision\": %.6f, \"recall\": %.6f, \"fmeasure\": %.6f, \"bandaccuracy\": %.6f}",
+				e.tp,e.fp,e.fn,e.tn,e.boxsize,e.errorrate,e.iou,e.precision,e.recall,e.fmeasure,e.bandaccuracy);
+		}
+		fprintf(f,"}%s\n",(i+1<items.size()) ? "," : "");
+	}
+	fprintf(f,"  ]\n}");
+}
+
+int main(int argc, char * argv[])
+{
+	BenchConfig config;
+	string folder, jsonfile, reportfile;
+	bool compare = false; // --binning both
+	for(int i=1;i<argc;i++){
+		string arg = argv[i];
+		bool hasvalue = (i+1<argc);
+		if(arg=="--reps" && hasvalue) config.reps = atoi(argv[++i]);
+		else if(arg=="--warmup" && hasvalue) config.warmup = atoi(argv[++i]);
+		else if(arg=="--binsize" && hasvalue) config.binsize = atoi(argv[++i]);
+		else if(arg=="--connectivity" && hasvalue) config.connectivity = atoi(argv[++i]);
+		else if(arg=="--lambda" && hasvalue) config.lambda = atof(argv[++i]);
+		else if(arg=="--maxflow" && hasvalue){
+			string m = argv[++i];
+			config.maxflowoption = (m=="bk") ? BK : ((m=="pr") ? PUSHRELABEL : ((m=="grid") ? GRID : IBFS));
+		}
+		else if(arg=="--band" && hasvalue) config.bandwidth = atoi(argv[++i]);
+		else if(arg=="--json" && hasvalue) jsonfile = argv[++i];
+		else if(arg=="--report" && hasvalue) reportfile = argv[++i];
+		else if(arg=="--binning" && hasvalue && (string(argv[i+1])=="uniform" || string(argv[i+1])=="mediancut" || string(argv[i+1])=="both")){
+			string b = argv[++i];
+			compare = (b=="both");
+			config.binningoption = (b=="mediancut") ? MEDIANCUT : UNIFORMBINS;
+		}
+		else if(arg=="--bins" && hasvalue) config.numbins = atoi(argv[++i]);
+		else if(arg[0]!='-' && folder.empty()) folder = arg;
+		else{
+			cerr<<"usage: "<<argv[0]<<" folder [--reps n] [--warmup n] [--binsize n] [--connectivity n] [--lambda w]"
+				" [--maxflow ibfs|bk|pr|grid] [--band r] [--json file] [--report file] [--binning uniform|mediancut|both] [--bins n]"<<endl;
+			return 1;
+		}
+	}
+	if(folder.empty()) folder = "images";
+	if(config.reps<1) config.reps = 1;
+	if(config.warmup<0) config.warmup = 0;
+	if(config.numbins<1) config.numbins = 1;
+
+	vector<BenchItem> found = finditems(folder);
+	if(found.empty()){
+		cerr<<"no items (name.bmp with name_box.bmp) in "<<folder<<endl;
+		return 1;
+	}
+	vector<BenchConfig> configs(1,config);
+	if(compare){
+		configs[0].binningoption = UNIFORMBINS;
+		configs.push_back(config);
+		configs[1].binningoption = MEDIANCUT;
+	}
+	OneCut onecut;
+	MemArena arena;
+	vector<vector<BenchItem> > runs(configs.size(),found);
+	for(size_t c=0;c<configs.size();c++)
+		for(size_t i=0;i<runs[c].size();i++){
+			runitem(runs[c][i],configs[c],onecut,arena);
+			cerr<<"["<<i+1<<"/"<<runs[c].size()<<"] "<<runs[c][i].name<<" ("<<binningname(configs[c])<<")"<<endl;
+		}
+
+	FILE * report = reportfile.empty() ? stdout : fopen(reportfile.c_str(),"w");
+	if(report==NULL){ cerr<<"can not write "<<reportfile<<endl; return 1; }
+	for(size_t c=0;c<configs.size();c++){
+		if(c>0) fprintf(report,"\n\n");
+		writereport(report,runs[c],configs[c]);
+	}
+	if(compare){
+		fprintf(report,"\n\n%-10s %12s %12s %12s\n","binning","uniform","mediancut","change");
+		fprintf(report,"%-10s %12.1f %12.1f %11.1f%%\n","bins",meancolorbins(runs[0]),meancolorbins(runs[1]),
+			100*(meancolorbins(runs[1])/meancolorbins(runs[0])-1));
+		for(int p=PHASE_SETIMAGE;p<NUM_PHASES;p++){
+			if(p==PHASE_EVAL) continue;
+			double a = meantime(runs[0],p), b = meantime(runs[1],p);
+			fprintf(report,"%-10s %12.3f %12.3f %11.1f%%\n",phasenames[p],a,b,a>0 ? 100*(b/a-1) : 0);
+		}
+		if(meanerrorrate(runs[0])>=0)
+			fprintf(report,"%-10s %12.4f %12.4f %+12.4f\n","errorrate",meanerrorrate(runs[0]),meanerrorrate(runs[1]),
+				meanerrorrate(runs[1])-meanerrorrate(runs[0]));
+	}
+	if(report!=stdout) fclose(report);
+	if(!jsonfile.empty()){
+		FILE * json = fopen(jsonfile.c_str(),"w");
+		if(json==NULL){ cerr<<"can not write "<<jsonfile<<endl; return 1; }
+		// one run is an object, the comparison an array of the two
+		if(compare) fprintf(json,"[\n");
+		for(size_t c=0;c<configs.size();c++){
+			writejson(json,runs[c],configs[c]);
+			fprintf(json,(c+1<configs.size()) ? ",\n" : "\n");
+		}
+		if(compare) fprintf(json,"]\n");
+		fclose(json);
+	}
+	return 0;
+}
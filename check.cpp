@@ -0,0 +1,593 @@
+/***********************************************************************************/
+/*          OneCut - software for interactive image segmentation                   */
+/*          "Grabcut in One Cut"                                                   */
+/*          Meng Tang, Lena Gorelick, Olga Veksler, Yuri Boykov,                   */
+/*          In IEEE International Conference on Computer Vision (ICCV), 2013       */
+/*          https://github.com/meng-tang/OneCut                                    */
+/*          Contact Author: Meng Tang (mtang73@uwo.ca)                             */
+/***********************************************************************************/
+
+// Self checks on the sample in images/, run from the repository root: ./check
+// Prints one line per check and returns non-zero if any of them fails.
+//
+//   alloc      the image, box and segmentation buffers are allocated once per pipeline (Table2D moves)
+//   boxes      runboxes() matches the cut of the whole image graph for a box away from the image border
+//   volume     OneCut3D at 6, 18 and 26-connectivity cuts a bright cube out of a synthetic volume, and on one
+//              slice of the gray sample has the flow of OneCut at 4 and 8-connectivity
+//   sweep      sweep() flows and masks equal fresh solves of every setting
+//   components runcomponents() flow and labels equal those of the whole graph
+//   reduced    runreduced() flow and labels equal the maximal min cut of the whole graph
+//   parametric parametricballooning() labels equal the maximal min cut of every ballooning weight
+//   pr         push-relabel flows and cuts equal IBFS on the sample at 4, 8 and 16-connectivity and on random
+//              graphs with parallel edges at 1, 3 and 16 threads
+//   grid       GridGraph flows and cuts equal IBFS on the sample at 4, 8 and 16-connectivity and on 6000 random
+//              grids with explicit edges and hub nodes
+//   tiled      TiledCut energies are at least the flow of OneCut and its lower bounds at most, one tile is exact
+//   server     ./server over its socket, driven by ServerClient: masks match OneCut, errors, eviction, quit
+
+#include "OneCut.h"
+#include "OneCut3D.h"
+#include "TiledCut.h"
+#include "myutil.h"
+#include "ServerClient.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+// Table2D allocates its containers through the aligned operator new[], counted here
+static int table2dallocs = 0;
+
+void * operator new[](size_t size, std::align_val_t alignment)
+{
+	size_t a = (size_t)alignment;
+	void * p = aligned_alloc(a, (size+a-1)/a*a);
+	if(p==NULL) throw std::bad_alloc();
+	table2dallocs++;
+	return p;
+}
+void operator delete[](void * p, std::align_val_t) noexcept {free(p);}
+void operator delete[](void * p, size_t, std::align_val_t) noexcept {free(p);}
+
+static int failures = 0;
+
+static void report(const char * name, bool ok, const char * detail)
+{
+	printf("%-10s %s  %s\n", name, ok ? "ok    " : "FAILED", detail);
+	if(!ok) failures++;
+}
+
+// the pipeline of main.cpp: the image is not copied by OneCut, the box is handed over, the segmentation
+// is allocated by run() and reused by run(segmentation)
+static void checkalloc()
+{
+	Table2D<RGB> image = loadImage<RGB>("images/326038.bmp");
+	Table2D<int> box = loadImage<RGB>("images/326038_box.bmp");
+
+	table2dallocs = 0;
+	OneCut onecut(image, 8, 8, IBFS);
+	int constructallocs = table2dallocs; // the color bins only, no copy of the image
+
+	table2dallocs = 0;
+	onecut.constructbkgraph(std::move(box), 9.0);
+	int boxallocs = table2dallocs;
+
+	table2dallocs = 0;
+	Table2D<Label> segmentation = onecut.run();
+	int runallocs = table2dallocs;
+
+	table2dallocs = 0;
+	onecut.constructbkgraph(9.0);
+	onecut.run(segmentation);
+	int rerunallocs = table2dallocs;
+
+	char detail[256];
+	sprintf(detail, "OneCut() %d, constructbkgraph(move(box)) %d, run() %d, run(segmentation) %d Table2D allocations",
+		constructallocs, boxallocs, runallocs, rerunallocs);
+	report("alloc", (constructallocs==1)&&(boxallocs==0)&&(runallocs==1)&&(rerunallocs==0), detail);
+}
+
+// the sample box with its bottom cut 120 rows up, at 8-connectivity where n-links reach one row up
+static void checkboxes()
+{
+	Table2D<RGB> image = loadImage<RGB>("images/326038.bmp");
+	Table2D<int> samplebox = loadImage<RGB>("images/326038_box.bmp");
+	OneCut onecut(image, 8, 8, IBFS);
+	PointPair rect = onecut.setbox(Table2DView<int>(samplebox)).rect;
+	rect.p2.y -= 120;
+	Table2D<int> box(image.getWidth(), image.getHeight(), 255);
+	for(int x=rect.p1.x;x<=rect.p2.x;x++)
+		for(int y=rect.p1.y;y<=rect.p2.y;y++)
+			box[x][y] = 0;
+	onecut.setbox(std::move(box));
+	Table2D<Label> segmentation;
+	onecut.runcomponents(segmentation, 9.0);
+	double flow = onecut.getflow();
+
+	vector<BoxResult> results;
+	onecut.runboxes(vector<PointPair>(1, rect), results, 9.0);
+	int diff = 0;
+	for(int x=rect.p1.x;x<=rect.p2.x;x++)
+		for(int y=rect.p1.y;y<=rect.p2.y;y++)
+			diff += results[0].mask.get(x-rect.p1.x,y-rect.p1.y)!=(segmentation[x][y]==OBJ);
+
+	char detail[256];
+	sprintf(detail, "flow %.0f, runcomponents() %.0f, %d pixels differ", results[0].flow, flow, diff);
+	report("boxes", (results[0].flow==flow)&&(diff==0), detail);
+}
+
+// the maximal min cut of the graph of constructbkgraph() for the box and seeds set on onecut, one IBFS graph
+// run to completion: returns the flow, label[n] is 1 for OBJ
+static long long maximalmincut(OneCut & onecut, float weight_potts, float beta_prime, vector<unsigned char> & label,
+	float ballooning = 1)
+{
+	CutProblem cp;
+	onecut.buildcutproblem(cp, weight_potts, beta_prime, ballooning);
+	IBFSGraph g(IBFSGraph::IB_INIT_FAST);
+	g.initSize(cp.numnodes, (int)cp.edges.size());
+	for(int n=0;n<cp.numnodes;n++) g.addNode(n, cp.capsource[n], cp.capsink[n]);
+	for(size_t i=0;i<cp.edges.size();i++) g.addEdge(cp.edges[i].p, cp.edges[i].q, cp.edges[i].cap, cp.edges[i].cap);
+	g.initGraph();
+	g.computeMaxFlow(true);
+	label.resize(cp.numnodes);
+	for(int n=0;n<cp.numnodes;n++) label[n] = g.isNodeOnSrcSide(n,1)!=0;
+	return g.getFlow();
+}
+
+// pixels where segmentation and the labels of maximalmincut() differ
+static int differences(const Table2D<Label> & segmentation, const vector<unsigned char> & label)
+{
+	int w = segmentation.getWidth(), diff = 0;
+	for(int x=0;x<w;x++)
+		for(int y=0;y<segmentation.getHeight();y++)
+			diff += (segmentation[x][y]==OBJ)!=(label[x+y*w]!=0);
+	return diff;
+}
+
+// a background scribble along the top of the box and an object blob in its middle
+static Table2D<Label> sampleseeds(const Table2D<RGB> & image, const PointPair & rect)
+{
+	Table2D<Label> seeds(image.getWidth(), image.getHeight(), NONE);
+	for(int x=rect.p1.x;x<=rect.p2.x;x++) seeds[x][rect.p1.y+3] = BKG;
+	int cx = (rect.p1.x+rect.p2.x)/2, cy = (rect.p1.y+rect.p2.y)/2;
+	for(int x=cx-4;x<=cx+4;x++)
+		for(int y=cy-4;y<=cy+4;y++)
+			seeds[x][y] = OBJ;
+	return seeds;
+}
+
+// settings of lambda and beta_prime at 8 and then 4-connectivity, warm started from one another
+static void checksweep()
+{
+	Table2D<RGB> image = loadImage<RGB>("images/326038.bmp");
+	Table2D<int> box = loadImage<RGB>("images/326038_box.bmp");
+	vector<SweepPoint> points;
+	points.push_back(SweepPoint(9.0, 0.9, 8));
+	points.push_back(SweepPoint(3.0, 0.9, 8));
+	points.push_back(SweepPoint(20.0, 0.5, 8));
+	points.push_back(SweepPoint(9.0, 0.9, 4));
+	points.push_back(SweepPoint(15.0, 1.5, 4));
+	OneCut onecut(image, 8, 8, IBFS);
+	onecut.setbox(Table2DView<int>(box));
+	vector<SweepResult> results;
+	onecut.sweep(image, points, results);
+
+	int flowdiff = 0, maskdiff = 0;
+	for(size_t i=0;i<points.size();i++)
+	{
+		OneCut fresh(image, 8, points[i].connectivity, IBFS);
+		fresh.setbox(Table2DView<int>(box));
+		vector<unsigned char> label;
+		long long flow = maximalmincut(fresh, (float)points[i].weight_potts, (float)points[i].beta_prime, label);
+		flowdiff += (results[i].flow!=(double)flow);
+		for(int y=0;y<image.getHeight();y++)
+			for(int x=0;x<image.getWidth();x++)
+				maskdiff += results[i].mask.get(x,y)!=(label[x+y*image.getWidth()]!=0);
+	}
+	char detail[256];
+	sprintf(detail, "%d settings, %d flows and %d pixels differ from fresh solves", (int)points.size(), flowdiff, maskdiff);
+	report("sweep", (flowdiff==0)&&(maskdiff==0), detail);
+}
+
+// the sample box without and with seeds
+static void checkcomponents()
+{
+	Table2D<RGB> image = loadImage<RGB>("images/326038.bmp");
+	Table2D<int> box = loadImage<RGB>("images/326038_box.bmp");
+	OneCut onecut(image, 8, 8, IBFS);
+	PointPair rect = onecut.setbox(Table2DView<int>(box)).rect;
+	char detail[256] = "";
+	bool ok = true;
+	for(int seeded=0;seeded<2;seeded++)
+	{
+		if(seeded) onecut.setseeds(sampleseeds(image, rect));
+		onecut.constructbkgraph(9.0);
+		onecut.run();
+		double runflow = onecut.getflow();
+		vector<unsigned char> label;
+		maximalmincut(onecut, 9.0, 0.9, label);
+		Table2D<Label> segmentation;
+		int numcomponents = onecut.runcomponents(segmentation, 9.0);
+		int diff = differences(segmentation, label);
+		sprintf(detail+strlen(detail), "%s%s: %d components, flow %.0f, run() %.0f, %d pixels differ", seeded ? "; " : "",
+			seeded ? "seeds" : "box", numcomponents, onecut.getflow(), runflow, diff);
+		ok = ok && (onecut.getflow()==runflow) && (diff==0);
+	}
+	onecut.setseeds(Table2D<Label>());
+	report("components", ok, detail);
+}
+
+static void checkreduced()
+{
+	Table2D<RGB> image = loadImage<RGB>("images/326038.bmp");
+	Table2D<int> box = loadImage<RGB>("images/326038_box.bmp");
+	char detail[256] = "";
+	bool ok = true;
+	for(int seeded=0;seeded<2;seeded++)
+	{
+		OneCut onecut(image, 8, 8, IBFS);
+		PointPair rect = onecut.setbox(Table2DView<int>(box)).rect;
+		if(seeded) onecut.setseeds(sampleseeds(image, rect));
+		vector<unsigned char> label;
+		long long flow = maximalmincut(onecut, 9.0, 0.9, label);
+		Table2D<Label> segmentation;
+		onecut.runreduced(segmentation, 9.0);
+		int diff = differences(segmentation, label);
+		sprintf(detail+strlen(detail), "%s%s: flow %.0f, maximal min cut %lld, %d pixels differ", seeded ? "; " : "",
+			seeded ? "seeds" : "box", onecut.getflow(), flow, diff);
+		ok = ok && (onecut.getflow()==(double)flow) && (diff==0);
+	}
+	report("reduced", ok, detail);
+}
+
+// parametricballooning() on 21 weights against the maximal min cut of every weight, descending weights throw
+static void checkparametric()
+{
+	Table2D<RGB> image = loadImage<RGB>("images/326038.bmp");
+	Table2D<int> box = loadImage<RGB>("images/326038_box.bmp");
+	OneCut onecut(image, 8, 8, IBFS);
+	onecut.setbox(Table2DView<int>(box));
+	vector<double> weights;
+	for(int k=0;k<=20;k++) weights.push_back(0.15*k);
+	Table2D<int> firstindex;
+	onecut.parametricballooning(weights, firstindex, 9.0);
+	const int w = image.getWidth(), h = image.getHeight();
+	int diff = 0;
+	for(int k=0;k<(int)weights.size();k++)
+	{
+		vector<unsigned char> label;
+		maximalmincut(onecut, 9.0, 0.9, label, (float)weights[k]);
+		for(int x=0;x<w;x++)
+			for(int y=0;y<h;y++)
+				diff += (firstindex[x][y]<=k)!=(label[x+y*w]!=0);
+	}
+	bool thrown = false;
+	std::swap(weights[3], weights[4]);
+	try{ onecut.parametricballooning(weights, firstindex, 9.0); }
+	catch(const std::invalid_argument &){ thrown = true; }
+	char detail[256];
+	sprintf(detail, "%d weights, %d pixels differ from fresh solves, descending weights %s", (int)weights.size(), diff,
+		thrown ? "rejected" : "accepted");
+	report("parametric", (diff==0) && thrown, detail);
+}
+
+// deterministic pseudo random numbers in [0,n), the same graphs on every run
+static unsigned randomstate = 12345;
+static int randomint(int n)
+{
+	randomstate = randomstate*1103515245u+12345u;
+	return (int)((randomstate>>8)%(unsigned)n);
+}
+
+static void checkpr()
+{
+	Table2D<RGB> image = loadImage<RGB>("images/326038.bmp");
+	Table2D<int> box = loadImage<RGB>("images/326038_box.bmp");
+	char detail[256] = "";
+	bool ok = true;
+	const int connectivity[3] = {4, 8, 16};
+	for(int c=0;c<3;c++)
+	{
+		OneCut onecut(image, 8, connectivity[c], PUSHRELABEL);
+		onecut.constructbkgraph(Table2DView<int>(box), 9.0);
+		Table2D<Label> segmentation;
+		onecut.run(segmentation);
+		vector<unsigned char> label;
+		long long flow = maximalmincut(onecut, 9.0, 0.9, label);
+		int diff = differences(segmentation, label);
+		sprintf(detail+strlen(detail), "C=%d %d pixels differ, ", connectivity[c], diff);
+		ok = ok && (onecut.getflow()==(double)flow) && (diff==0);
+	}
+
+	// random graphs: every node pair may be joined several times, t-links to either or both terminals
+	const int threads[3] = {1, 3, 16};
+	int numgraphs = 0, wrong = 0;
+	for(int k=0;k<300;k++)
+	{
+		int n = 2+randomint(60), m = randomint(4*n);
+		vector<int> capsource(n), capsink(n), p(m), q(m), cap(m), rcap(m);
+		for(int i=0;i<n;i++){ capsource[i] = randomint(3) ? 0 : randomint(100); capsink[i] = randomint(3) ? 0 : randomint(100); }
+		for(int e=0;e<m;e++){
+			p[e] = randomint(n); q[e] = (p[e]+1+randomint(n-1))%n;
+			if(e>0 && randomint(4)==0){ p[e] = p[e-1]; q[e] = q[e-1]; } // parallel edge
+			cap[e] = randomint(50); rcap[e] = randomint(50);
+		}
+		IBFSGraph ibfs(IBFSGraph::IB_INIT_FAST);
+		ibfs.initSize(n, m);
+		for(int i=0;i<n;i++) ibfs.addNode(i, capsource[i], capsink[i]);
+		for(int e=0;e<m;e++) ibfs.addEdge(p[e], q[e], cap[e], rcap[e]);
+		ibfs.initGraph();
+		ibfs.computeMaxFlow(true);
+		for(int t=0;t<3;t++)
+		{
+			PushRelabelGraph pr;
+			pr.setNumThreads(threads[t]);
+			pr.initSize(n, m);
+			for(int i=0;i<n;i++) pr.addNode(i, capsource[i], capsink[i]);
+			for(int e=0;e<m;e++) pr.addEdge(p[e], q[e], cap[e], rcap[e]);
+			bool same = (pr.computeMaxFlow()==(long long)ibfs.getFlow());
+			for(int i=0;i<n;i++) same = same && (pr.isNodeOnSrcSide(i)==(ibfs.isNodeOnSrcSide(i,1)!=0));
+			wrong += !same;
+			numgraphs++;
+		}
+	}
+	sprintf(detail+strlen(detail), "%d of %d random graphs differ", wrong, numgraphs);
+	report("pr", ok && (wrong==0), detail);
+}
+
+static void checkgrid()
+{
+	Table2D<RGB> image = loadImage<RGB>("images/326038.bmp");
+	Table2D<int> box = loadImage<RGB>("images/326038_box.bmp");
+	char detail[256] = "";
+	bool ok = true;
+	const int connectivity[3] = {4, 8, 16};
+	for(int c=0;c<3;c++)
+	{
+		OneCut onecut(image, 8, connectivity[c], GRID);
+		onecut.constructbkgraph(Table2DView<int>(box), 9.0);
+		Table2D<Label> segmentation;
+		onecut.run(segmentation);
+		vector<unsigned char> label;
+		long long flow = maximalmincut(onecut, 9.0, 0.9, label);
+		int diff = differences(segmentation, label);
+		sprintf(detail+strlen(detail), "C=%d %d pixels differ, ", connectivity[c], diff);
+		ok = ok && (onecut.getflow()==(double)flow) && (diff==0);
+	}
+
+	// random grids: edges between pixels up to 2 apart (in the planes or explicit, parallel ones too),
+	// far pixel pairs and hub nodes joined to many pixels as the color bins of OneCut
+	int wrong = 0;
+	const int numgraphs = 6000;
+	for(int k=0;k<numgraphs;k++)
+	{
+		int w = 1+randomint(12), h = 1+randomint(12), conn = connectivity[randomint(3)];
+		int numpixels = w*h, n = numpixels+randomint(4), m = randomint(6*numpixels);
+		vector<int> capsource(n), capsink(n), p(m), q(m), cap(m), rcap(m);
+		for(int i=0;i<n;i++){ capsource[i] = randomint(3) ? 0 : randomint(100); capsink[i] = randomint(3) ? 0 : randomint(100); }
+		for(int e=0;e<m;e++){
+			int kind = randomint(8);
+			p[e] = randomint(numpixels);
+			if(kind<6){
+				int x = p[e]%w+randomint(5)-2, y = p[e]/w+randomint(5)-2;
+				q[e] = (x>=0 && x<w && y>=0 && y<h) ? x+y*w : randomint(numpixels);
+			}
+			else if(kind==6 || n==numpixels) q[e] = randomint(numpixels);
+			else q[e] = numpixels+randomint(n-numpixels);
+			if(e>0 && randomint(8)==0){ p[e] = p[e-1]; q[e] = q[e-1]; } // parallel edge
+			if(p[e]==q[e]) q[e] = (p[e]+1)%n;
+			cap[e] = randomint(50); rcap[e] = randomint(50);
+		}
+		IBFSGraph ibfs(IBFSGraph::IB_INIT_FAST);
+		ibfs.initSize(n, m);
+		for(int i=0;i<n;i++) ibfs.addNode(i, capsource[i], capsink[i]);
+		for(int e=0;e<m;e++) ibfs.addEdge(p[e], q[e], cap[e], rcap[e]);
+		ibfs.initGraph();
+		ibfs.computeMaxFlow(true);
+		GridGraph grid;
+		grid.initSize(w, h, conn, n-numpixels, m);
+		for(int i=0;i<n;i++) grid.addNode(i, capsource[i], capsink[i]);
+		for(int e=0;e<m;e++) grid.addEdge(p[e], q[e], cap[e], rcap[e]);
+		bool same = (grid.computeMaxFlow()==ibfs.getFlow());
+		for(int i=0;i<n;i++) same = same && (grid.isNodeOnSrcSide(i)==(ibfs.isNodeOnSrcSide(i,1)!=0));
+		wrong += !same;
+	}
+	sprintf(detail+strlen(detail), "%d of %d random grids differ", wrong, numgraphs);
+	report("grid", ok && (wrong==0), detail);
+}
+
+// 12^3 volume with a bright 4^3 cube in the middle of an 8^3 box, plus some texture so that bins differ
+static void checkvolume()
+{
+	const int n = 12;
+	Table3D<float> volume(n, n, n);
+	Table3D<unsigned char> cube(n, n, n);
+	for(int z=0;z<n;z++)
+		for(int y=0;y<n;y++)
+			for(int x=0;x<n;x++)
+			{
+				bool in = (x>=4)&&(x<=7)&&(y>=4)&&(y<=7)&&(z>=4)&&(z<=7);
+				cube.data()[x+y*n+z*n*n] = in ? 1 : 0;
+				volume.data()[x+y*n+z*n*n] = (in ? 200 : 50)+(x*7+y*3+z*5)%11;
+			}
+
+	char detail[256] = "";
+	bool ok = true;
+	const int connectivity[3] = {6, 18, 26};
+	for(int c=0;c<3;c++)
+	{
+		OneCut3D onecut(volume, 16, connectivity[c]);
+		onecut.constructgraph(volume, Cuboid(2,2,2,9,9,9), 2.0);
+		Table3D<unsigned char> mask;
+		onecut.run(mask);
+		int wrong = 0;
+		for(int i=0;i<n*n*n;i++) wrong += (mask.data()[i]!=0)!=(cube.data()[i]!=0);
+		sprintf(detail+strlen(detail), "%s%d-connected %d wrong voxels", c ? ", " : "", connectivity[c], wrong);
+		ok = ok && (wrong==0);
+	}
+
+	// a one-slice volume of the gray sample against OneCut at 4 and 8-connectivity, whose neighbors are
+	// the in-slice neighbors at 6 and 18: the same graph up to the order of the arcs, so the same flow
+	// (free pixels of tied cuts may go either way)
+	Table2D<RGB> image = loadImage<RGB>("images/326038.bmp");
+	int w = image.getWidth(), h = image.getHeight();
+	Table3D<float> slice(w, h, 1);
+	for(int x=0;x<w;x++)
+		for(int y=0;y<h;y++)
+		{
+			int g = ((int)image[x][y].r+image[x][y].g+image[x][y].b)/3;
+			image[x][y] = RGB(g,g,g);
+			slice.data()[x+y*w] = g;
+		}
+	Table2D<int> box(w, h, 255);
+	for(int x=163;x<=360;x++)
+		for(int y=20;y<=315;y++)
+			box[x][y] = 0;
+	Table2D<Label> segmentation;
+	for(int c=0;c<2;c++)
+	{
+		OneCut onecut(image, 16, c ? 8 : 4, IBFS);
+		onecut.setbox(static_cast<const Table2DView<int>&>(box));
+		onecut.constructbkgraph(3.0);
+		onecut.run(segmentation);
+		OneCut3D onecut3d(slice, 16, c ? 18 : 6);
+		onecut3d.constructgraph(slice, Cuboid(163,20,0,360,315,0), 3.0);
+		Table3D<unsigned char> mask;
+		onecut3d.run(mask);
+		sprintf(detail+strlen(detail), ", slice at %d: flow %.0f, OneCut %.0f", c ? 18 : 6, onecut3d.getflow(), onecut.getflow());
+		ok = ok && (onecut3d.getflow()==onecut.getflow());
+	}
+	report("volume", ok, detail);
+}
+
+// the sample through temporary mappings at tiles covering the box and of 128, 64 and 32 pixels
+static void checktiled()
+{
+	Table2D<RGB> image = loadImage<RGB>("images/326038.bmp");
+	const int w = image.getWidth(), h = image.getHeight();
+	char imagefile[64], maskfile[64];
+	sprintf(imagefile, "/tmp/onecut-check-%d.ppm", (int)getpid());
+	sprintf(maskfile, "/tmp/onecut-check-%d.pgm", (int)getpid());
+	MappedPNM mapped, mask;
+	if(!mapped.create(imagefile, w, h, 3) || !mask.create(maskfile, w, h, 1)){
+		report("tiled", false, "cannot create the mappings in /tmp");
+		return;
+	}
+	for(int y=0;y<h;y++)
+		for(int x=0;x<w;x++){
+			unsigned char * p = mapped.row(y)+3*x;
+			p[0] = image[x][y].r; p[1] = image[x][y].g; p[2] = image[x][y].b;
+		}
+	Table2D<int> box(w, h, 255);
+	for(int x=163;x<=360;x++)
+		for(int y=20;y<=315;y++)
+			box[x][y] = 0;
+	OneCut onecut(image, 8, 8, IBFS);
+	onecut.setbox(std::move(box));
+	onecut.constructbkgraph(9.0);
+	Table2D<Label> segmentation;
+	onecut.run(segmentation);
+	const double flow = onecut.getflow();
+
+	char detail[256];
+	sprintf(detail, "OneCut %.0f", flow);
+	bool ok = true;
+	const int tiles[4] = {1024, 128, 64, 32};
+	for(int t=0;t<4;t++)
+	{
+		TiledCut tiled(tiles[t], 8, 8, 9.0);
+		double energy = tiled.run(mapped, 163, 20, 360, 315, mask);
+		sprintf(detail+strlen(detail), ", tile %d: %.0f >= %.0f", tiles[t], energy, tiled.getLowerBound());
+		ok = ok && (energy>=flow) && (tiled.getLowerBound()<=flow);
+		if(t==0) ok = ok && (energy==flow) && (tiled.getLowerBound()==flow);
+	}
+	mapped.close();
+	mask.close();
+	unlink(imagefile);
+	unlink(maskfile);
+	report("tiled", ok, detail);
+}
+
+// starts ./server on a private socket with one worker and room for two sessions and plays a conversation with it
+static void checkserver()
+{
+	const char * image = "images/326038.bmp", * boxfile = "images/326038_box.bmp";
+	char socketpath[64];
+	sprintf(socketpath, "/tmp/onecut-check-%d.sock", (int)getpid());
+	if(access("./server", X_OK)!=0){ report("server", false, "./server is not built"); return; }
+	pid_t pid = fork();
+	if(pid==0){
+		execl("./server", "server", "--socket", socketpath, "--workers", "1", "--sessions", "2", (char*)NULL);
+		_exit(127);
+	}
+	ServerClient client;
+	for(int tries=0;tries<500 && !client.connect(socketpath);tries++) usleep(10000);
+
+	// the mask of OneCut in this process
+	Table2D<RGB> img = loadImage<RGB>(image);
+	Table2D<int> box = loadImage<RGB>(boxfile);
+	OneCut onecut(img, 8, 8, IBFS);
+	onecut.constructbkgraph(std::move(box), 9.0);
+	vector<unsigned char> expected((size_t)img.getWidth()*img.getHeight());
+	int expectedobj = onecut.run(&expected[0], 255, 0);
+
+	string failed;
+	ServerClient::Header r;
+	vector<unsigned char> mask;
+	auto expect = [&](const string & request, const string & status, const string & what){
+		bool ok = client.request(request, r, mask) && (r["status"]==status);
+		if(!ok && failed.empty()) failed = what;
+		return ok;
+	};
+	expect("cmd=ping id=1", "ok", "ping");
+	if(expect("cmd=segment id=2 session=a image="+string(image)+" boxfile="+boxfile+" lambda=9", "ok", "segment")
+		&& (mask!=expected || atoi(r["obj"].c_str())!=expectedobj) && failed.empty()) failed = "mask";
+	if(expect("cmd=segment id=3 session=a output=bits", "ok", "bits")){
+		BitMask bits(img.getWidth(), img.getHeight());
+		memcpy(bits.data(), &mask[0], std::min(mask.size(), bits.getBytes()));
+		int diff = (mask.size()!=bits.getBytes());
+		for(int y=0;y<img.getHeight();y++)
+			for(int x=0;x<img.getWidth();x++)
+				diff += bits.get(x,y)!=(expected[x+y*img.getWidth()]!=0);
+		if(diff && failed.empty()) failed = "bits";
+	}
+	if(expect("cmd=segment id=4 session=a maxflow=foo", "error", "unknown maxflow") && r["msg"]!="unknown_maxflow" && failed.empty())
+		failed = "unknown maxflow message";
+	// b fills the worker, c evicts a, the least recently used session
+	for(const char * name : {"b", "c"})
+		expect("cmd=segment id=5 session="+string(name)+" image="+image+" box=10,10,100,100", "ok", "more sessions");
+	if(expect("cmd=segment id=6 session=a", "error", "eviction") && r["msg"]!="no_image_in_session" && failed.empty())
+		failed = "eviction message";
+	expect("cmd=segment id=7 bytes=-1", "error", "invalid bytes");
+	if(client.receive(r, mask) && failed.empty()) failed = "connection open after invalid bytes";
+
+	client.connect(socketpath);
+	client.send("cmd=quit");
+	int status = -1;
+	for(int tries=0;tries<500 && waitpid(pid, &status, WNOHANG)==0;tries++) usleep(10000);
+	if(!WIFEXITED(status)){ kill(pid, SIGKILL); waitpid(pid, &status, 0); if(failed.empty()) failed = "quit"; }
+	else if(WEXITSTATUS(status)!=0 && failed.empty()) failed = "exit status";
+
+	char detail[256];
+	if(failed.empty()) sprintf(detail, "ping, masks of %d OBJ pixels as OneCut, unknown_maxflow, eviction, invalid_bytes, quit", expectedobj);
+	else sprintf(detail, "%s failed", failed.c_str());
+	report("server", failed.empty(), detail);
+}
+
+int main(int argc, char * argv[])
+{
+	signal(SIGPIPE, SIG_IGN);
+	checkalloc();
+	checkboxes();
+	checkvolume();
+	checksweep();
+	checkcomponents();
+	checkreduced();
+	checkparametric();
+	checkpr();
+	checkgrid();
+	checktiled();
+	checkserver();
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,75 @@
+/***********************************************************************************/
+/*          OneCut - software for interactive image segmentation                   */
+/*          "Grabcut in One Cut"                                                   */
+/*          Meng Tang, Lena Gorelick, Olga Veksler, Yuri Boykov,                   */
+/*          In IEEE International Conference on Computer Vision (ICCV), 2013       */
+/*          https://github.com/meng-tang/OneCut                                    */
+/*          Contact Author: Meng Tang (mtang73@uwo.ca)                             */
+/***********************************************************************************/
+
+// Local client of the segmentation server: sends every request in order over the socket of
+// "server --socket path" and prints the header line of each response.
+//
+// usage: client path request... [--mask file.pgm]
+//   each request is one header line of the protocol of server.cpp, e.g.
+//   client /tmp/onecut.sock "cmd=segment id=1 session=a image=images/326038.bmp box=163,20,360,315"
+//   --mask writes the mask of the last response with output=bytes as a PGM (255 = OBJ)
+// Returns 0 if every response has status=ok. cmd=quit is not answered and ends the requests.
+
+#include "ServerClient.h"
+#include <iostream>
+#include <stdio.h>
+
+using namespace std;
+
+int main(int argc, char * argv[])
+{
+	string socketpath, maskfile;
+	vector<string> requests;
+	for(int i=1;i<argc;i++){
+		string arg = argv[i];
+		if(arg=="--mask" && i+1<argc) maskfile = argv[++i];
+		else if(socketpath.empty()) socketpath = arg;
+		else requests.push_back(arg);
+	}
+	if(socketpath.empty() || requests.empty()){
+		cerr<<"usage: "<<argv[0]<<" path request... [--mask file.pgm]"<<endl;
+		return 1;
+	}
+	ServerClient client;
+	if(!client.connect(socketpath.c_str())){
+		cerr<<"can not connect to "<<socketpath<<endl;
+		return 1;
+	}
+	bool ok = true;
+	ServerClient::Header response;
+	vector<unsigned char> mask;
+	for(size_t i=0;i<requests.size();i++){
+		if(ServerClient::parse(requests[i])["cmd"]=="quit"){ // not answered, the server closes the connection
+			client.send(requests[i]);
+			break;
+		}
+		if(!client.request(requests[i],response,mask)){
+			cerr<<"the server closed the connection"<<endl;
+			return 1;
+		}
+		cout<<client.getLine()<<endl;
+		ok = ok && (response["status"]=="ok");
+	}
+	if(!maskfile.empty()){
+		int w = atoi(response["width"].c_str()), h = atoi(response["height"].c_str());
+		if(response["status"]!="ok" || !response["output"].empty() || mask.size()!=(size_t)w*h){
+			cerr<<"the last response has no mask of bytes"<<endl;
+			return 1;
+		}
+		FILE * f = fopen(maskfile.c_str(),"wb");
+		if(f==NULL){
+			cerr<<"can not write "<<maskfile<<endl;
+			return 1;
+		}
+		fprintf(f,"P5\n%d %d\n255\n",w,h);
+		fwrite(&mask[0],1,mask.size(),f);
+		fclose(f);
+	}
+	return ok ? 0 : 1;
+}
@@ -51,16 +51,16 @@ public:
     Vect operator-(const Vect& a) const {return Vect(x-a.x,y-a.y);}
 };
 
-Point :: Point( ) { x=0; y=0; }
+inline Point :: Point( ) { x=0; y=0; }
 
-Point :: Point( int x_init, int y_init ) {// construct the point specified by the parameters
+inline Point :: Point( int x_init, int y_init ) {// construct the point specified by the parameters
     x = x_init;
     y = y_init;
 }
 
-Vect :: Vect( ) { x=0; y=0; }
+inline Vect :: Vect( ) { x=0; y=0; }
 
-Vect :: Vect( double x_init, double y_init ) {// construct the vector specified by the parameters
+inline Vect :: Vect( double x_init, double y_init ) {// construct the vector specified by the parameters
     x = x_init;
     y = y_init;
 }
@@ -78,8 +78,8 @@ public:
     Vect3D operator-(const Vect3D& a) const {return Vect3D(x-a.x,y-a.y,z-a.z);}
 };
 
-Vect3D :: Vect3D( ) { x=0; y=0; z=0;}
-Vect3D :: Vect3D( double x_init, double y_init, double z_init ) {// construct the vector specified by the parameters
+inline Vect3D :: Vect3D( ) { x=0; y=0; z=0;}
+inline Vect3D :: Vect3D( double x_init, double y_init, double z_init ) {// construct the vector specified by the parameters
     x = x_init;
     y = y_init;
     z = z_init;
@@ -146,6 +146,9 @@ Table2D<RGB> autoScale(const Table2D<T>& a)        {return convert<RGB>(a,0,255)
 template <class T>  // creates Table2D of type "T" from BMP file, uses RGB->T cast orerator (if defined for RGB class above)
 Table2D<T> loadImage(const char * bmp_file_name);  // loaded table gets range of values in [0,255]. 
 
+template <class T>  // as above, but loads into existing table or view (e.g. a tile of a larger image) without allocating
+bool loadImage(const char * bmp_file_name, const Table2DView<T>& trg); // PRECONDITION: BMP size must match "trg"
+
 template <class T>  // saves Table2D of type "T" to BMP file, uses T->RGB cast orerator (if defined for RGB class above)
 bool saveImage(const Table2D<T>& arr, const char * bmp_file_name); // arr's values outside [0,255] are truncated at 0 or 255. 
 
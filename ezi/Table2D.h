@@ -2,6 +2,8 @@
 #define _TABLE2D_H_
 #include "Basics2D.h"
 
+#define TABLE2D_ALIGNMENT 64 // containers start on a cache line / vector register boundary
+
 //////////////////////////////////////////////////////////////////////////////////////////
 // THIS FILE DEFINES (TEMPLATED) CLASS "Table2D" REPRESENTING 2D ARRAYS WITH ELEMENTS   //
 // OF ANY TYPE "T".   BASIC MATHEMATICAL OPERATIONS FOR Table2D OBJECTS ARE IN Math2D.h //
@@ -9,6 +11,8 @@
 //////////////////////////////////////////////////////////////////////////////////////////
 
 
+template <class T> class Table2DView;
+
 template <class T>
 class Table2D {
 public:
@@ -18,18 +22,22 @@ public:
     Table2D(unsigned width, unsigned height, T val); // as above, but also initializes all values in the array
     Table2D(const Table2D<T>& src); // copy constructor
     Table2D<T>& operator=(const Table2D<T>& src); // copy operator
+    Table2D(Table2D<T>&& src); // move constructor (takes over the container of "src", leaving it empty)
+    Table2D<T>& operator=(Table2D<T>&& src); // move operator
     ~Table2D(); // destructor
 
     template <class type>              // conversion constructor that works
     Table2D(const Table2D<type>& src); // works if casting from "type" to "T" is defined
     template <class type>                            // conversion operator that works
     Table2D<T>& operator=(const Table2D<type>& src); // if casting "type->T" is defined
+    explicit Table2D(const Table2DView<T>& src); // copies the viewed sub-array into a new container
 	bool operator==(const Table2D<T>& src); // if casting "type->T" is defined
  
         // basic quiry functions
     bool isEmpty() const {return (m_container==NULL);} // checks if array is empty (zero width and/or height)
     unsigned getWidth() const {return m_width;} 
     unsigned getHeight() const {return m_height;}
+    unsigned getPitch() const {return m_pitch;} // distance between the first items of two adjacent columns (>= height)
     T getMin() const; // uses operator "<" for type "T"  PRECONDITION: Table should be non empty
     T getMax() const; // uses operator ">" for type "T"  PRECONDITION: Table should be non empty
 	T getMean() const; // uses operator ">" for type "T"  PRECONDITION: Table should be non empty
@@ -46,7 +54,8 @@ public:
     T& operator[](Point p) const;     // PRECONDITION: coordinates of p=(x,y) must be in-range
 
         // functions for resizing/resetting arrays
-    Table2D<T>& resize(unsigned width, unsigned height); // creates new container (but values are not initialized)
+    Table2D<T>& resize(unsigned width, unsigned height); // creates new container unless the current one is large enough (values are not initialized)
+    Table2D<T>& resizePadded(unsigned width, unsigned height); // as above, but pads each column so that every column starts aligned
     Table2D<T>& resize(int zoom); // positive "zoom" zooms-up, negative "zoom" zooms-down, zero generates empty Table
     Table2D<T>& reset(T val); // assigns new value to all items
     Table2D<T>& reset(unsigned width, unsigned height, T val) {resize(width,height); return reset(val);}
@@ -73,7 +82,48 @@ private:
     T* m_container;
     unsigned m_width;
     unsigned m_height;
+    unsigned m_pitch;
+    unsigned m_capacity; // number of items allocated in the container (>= width*pitch)
+
+    Table2D<T>& reshape(unsigned width, unsigned height, unsigned pitch);
+    static T* allocate(unsigned size);
+    static void deallocate(T* container, unsigned size);
+    static unsigned paddedPitch(unsigned height);
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// "Table2DView" IS A NON-OWNING (STRIDED) WINDOW INTO THE CONTAINER OF A Table2D OR    //
+// ANY OTHER COLUMN-MAJOR BUFFER. IT IS CHEAP TO COPY AND ALLOWS CROPS / ROIs WITHOUT   //
+// COPYING ANY DATA. THE VIEWED BUFFER MUST OUTLIVE THE VIEW.                           //
+//////////////////////////////////////////////////////////////////////////////////////////
+
+template <class T>
+class Table2DView {
+public:
+    Table2DView() : m_data(NULL), m_width(0), m_height(0), m_stride(0) {} // empty view
+    Table2DView(T* data, unsigned width, unsigned height, unsigned stride) // item (x,y) is data[x*stride+y]
+        : m_data(data), m_width(width), m_height(height), m_stride(stride) {}
+    Table2DView(const Table2D<T>& src) // views the whole table
+        : m_data(src.isEmpty() ? NULL : src[0u]), m_width(src.getWidth()), m_height(src.getHeight()), m_stride(src.getPitch()) {}
+
+    bool isEmpty() const {return (m_data==NULL);}
+    unsigned getWidth() const {return m_width;}
+    unsigned getHeight() const {return m_height;}
+    unsigned getStride() const {return m_stride;} // distance between the first items of two adjacent columns
+    bool pointIn(unsigned x, unsigned y) const {return (x<m_width && y<m_height);}
+    bool pointIn(int x, int y) const {return (0<=x && ((unsigned)x)<m_width && 0<=y && ((unsigned)y)<m_height);}
+    bool pointIn(Point p) const {return pointIn(p.x,p.y);}
+
+        // same access syntax as Table2D: "v[x][y]" or "v[p]"
+    T* operator[](unsigned x) const;  // Note: "v[x]" returns address of the first item in column "x"
+    T* operator[](int x) const;       // PRECONDITION: column index "x" must be in-range
+    T& operator[](Point p) const;     // PRECONDITION: coordinates of p=(x,y) must be in-range
 
+private:
+    T* m_data;
+    unsigned m_width;
+    unsigned m_height;
+    unsigned m_stride;
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////
@@ -88,10 +138,19 @@ Table2D<type> convert(const Table2D<T>& src, type (*f) (T));
 template <class type, class T, class Conversion>  // f - "conversion functor" with "convert(type,T)" method
 Table2D<type> convert(const Table2D<T>& src, const Conversion& f);
 
-    // global function for cropping Table2D objects
+    // global functions for cropping Table2D objects
 template <class T> // returns new sub-array of the same type, PRECONDITION: corner points should be within the range of src table
 Table2D<T> crop(const Table2D<T>& src, const Point corner1, const Point corner2);
 
+template <class T> // as above, for a sub-array of a view
+Table2D<T> crop(const Table2DView<T>& src, const Point corner1, const Point corner2);
+
+template <class T> // returns a view of the sub-array without copying, PRECONDITION: as for "crop"
+Table2DView<T> cropView(const Table2D<T>& src, const Point corner1, const Point corner2);
+
+template <class T> // as above, for a sub-array of a view
+Table2DView<T> cropView(const Table2DView<T>& src, const Point corner1, const Point corner2);
+
 template <class T> // scalar multiplication
 Table2D<T> operator*(const Table2D<T>& a, const double& scalar); 
 
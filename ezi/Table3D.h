@@ -0,0 +1,52 @@
+#ifndef _TABLE3D_H_
+#define _TABLE3D_H_
+#include <vector>
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// THIS FILE DEFINES (TEMPLATED) CLASS "Table3D" REPRESENTING 3D ARRAYS (VOLUMES) WITH  //
+// ELEMENTS OF ANY TYPE "T" EXCEPT bool. ITEMS ARE STORED SLICE BY SLICE, EACH SLICE    //
+// ROW BY ROW: item (x,y,z) is at index x+y*width+z*width*height, the node numbering    //
+// of OneCut3D, so that a slice is one contiguous block of width*height items.          //
+//////////////////////////////////////////////////////////////////////////////////////////
+
+template <class T>
+class Table3D {
+public:
+    Table3D(); // creates an empty array
+    Table3D(unsigned width, unsigned height, unsigned depth); // values are not initialized for POD types
+    Table3D(unsigned width, unsigned height, unsigned depth, T val);
+
+        // basic quiry functions
+    bool isEmpty() const {return m_container.empty();}
+    unsigned getWidth() const {return m_width;}
+    unsigned getHeight() const {return m_height;}
+    unsigned getDepth() const {return m_depth;}
+    size_t getSliceSize() const {return (size_t)m_width*m_height;}
+    size_t getSize() const {return m_container.size();}
+    T getMin() const; // PRECONDITION: Table should be non empty
+    T getMax() const; // PRECONDITION: Table should be non empty
+    bool pointIn(int x, int y, int z) const {
+        return (0<=x && ((unsigned)x)<m_width && 0<=y && ((unsigned)y)<m_height && 0<=z && ((unsigned)z)<m_depth);
+    }
+
+        // item access: "a(x,y,z)", "a.slice(z)" returns the address of the first item of slice "z"
+    T& operator()(int x, int y, int z) {return m_container[index(x,y,z)];}
+    const T& operator()(int x, int y, int z) const {return m_container[index(x,y,z)];}
+    T* slice(int z) {return &m_container[z*getSliceSize()];}
+    const T* slice(int z) const {return &m_container[z*getSliceSize()];}
+    T* data() {return m_container.empty() ? NULL : &m_container[0];}
+    const T* data() const {return m_container.empty() ? NULL : &m_container[0];}
+    size_t index(int x, int y, int z) const {return x+(size_t)y*m_width+(size_t)z*m_width*m_height;}
+
+        // functions for resizing/resetting arrays
+    Table3D<T>& resize(unsigned width, unsigned height, unsigned depth); // keeps the container if large enough
+    Table3D<T>& reset(T val); // assigns new value to all items
+    Table3D<T>& reset(unsigned width, unsigned height, unsigned depth, T val); // resize + reset
+
+private:
+    std::vector<T> m_container;
+    unsigned m_width, m_height, m_depth;
+};
+
+#include "Table3D.template"
+#endif
@@ -0,0 +1,507 @@
+#include "gridflow.h"
+#include <string.h>
+#include <limits.h>
+#include <algorithm>
+
+#define GF_PAD 2 // ghost pixels on every side, the largest shift of the neighborhoods
+#define GF_EXPORT_BLOCK (1<<16) // nodes per block of getNodeSides(), a multiple of 8 so that packed blocks do not share bytes
+
+// the shifts of OneCut's neighborhoods, connectivity C uses the first C/2, direction 2i is shift i and
+// direction 2i+1 its reverse
+static const int gridflowShiftX[8] = {1,0,1,1,2,2,1,-1};
+static const int gridflowShiftY[8] = {0,1,1,-1,-1,1,2,2};
+
+GridGraph::GridGraph(MemArena *a_arena)
+	: arena(a_arena), width(0), height(0), numDirs(0), blocksX(0), numGrid(0), numNodes(0),
+	numExtra(0), maxExtra(0), flow(0), bytes(0),
+	rcap(NULL), tcap(NULL), extraHead(NULL), extraRcap(NULL), extraRev(NULL), firstExtra(NULL),
+	extraSorted(false), label(NULL), parent(NULL), current(NULL),
+	firstSon(NULL), nextSon(NULL), prevSon(NULL),
+	topLevelS(0), topLevelT(0), numOrphansS(0), numOrphansT(0), maxExcessS(0), maxExcessT(0)
+{
+}
+
+GridGraph::~GridGraph()
+{
+	release(rcap); release(tcap);
+	release(extraHead); release(extraRcap); release(extraRev); release(firstExtra);
+	release(label); release(parent); release(current);
+	release(firstSon); release(nextSon); release(prevSon);
+}
+
+template <class T> T* GridGraph::allocate(size_t n)
+{
+	bytes += sizeof(T)*n;
+	return (arena != NULL ? arena->alloc<T>(n) : new T[n]);
+}
+
+template <class T> void GridGraph::release(T *p)
+{
+	if (arena == NULL) delete [] p;
+}
+
+long long GridGraph::getNumGridEdges(int width, int height, int connectivity)
+{
+	long long n = 0;
+	for (int i=0; i<connectivity/2; i++) {
+		int w = width - (gridflowShiftX[i] < 0 ? -gridflowShiftX[i] : gridflowShiftX[i]);
+		int h = height - (gridflowShiftY[i] < 0 ? -gridflowShiftY[i] : gridflowShiftY[i]);
+		if (w > 0 && h > 0) n += (long long)w*h;
+	}
+	return n;
+}
+
+void GridGraph::initSize(int a_width, int a_height, int connectivity, int numExtraNodes, int numExtraEdges)
+{
+	width = a_width;
+	height = a_height;
+	numDirs = connectivity;
+	for (int i=0; i<25; i++) dirOf[i] = -1;
+	for (int i=0; i<numDirs/2; i++) {
+		shiftX[2*i] = gridflowShiftX[i]; shiftY[2*i] = gridflowShiftY[i];
+		shiftX[2*i+1] = -gridflowShiftX[i]; shiftY[2*i+1] = -gridflowShiftY[i];
+	}
+	for (int d=0; d<numDirs; d++) dirOf[(shiftY[d]+2)*5+shiftX[d]+2] = d;
+	blocksX = (width+2*GF_PAD+7) >> 3;
+	int blocksY = (height+2*GF_PAD+7) >> 3;
+	numGrid = blocksX*blocksY*64;
+	numNodes = numGrid + numExtraNodes;
+	numExtra = 0;
+	maxExtra = numExtraEdges;
+	bytes = 0;
+
+	rcap = allocate<int>((size_t)numDirs*numGrid);
+	memset(rcap, 0, sizeof(int)*(size_t)numDirs*numGrid);
+	tcap = allocate<int>(numNodes);
+	memset(tcap, 0, sizeof(int)*numNodes);
+	extraHead = allocate<int>(2*(size_t)maxExtra);
+	extraRcap = allocate<int>(2*(size_t)maxExtra);
+	extraRev = allocate<int>(2*(size_t)maxExtra);
+	firstExtra = allocate<int>(numNodes+1);
+	extraSorted = false;
+	label = allocate<int>(numNodes);
+	parent = allocate<int>(numNodes);
+	current = allocate<int>(numNodes);
+	firstSon = allocate<int>(numNodes);
+	nextSon = allocate<int>(numNodes);
+	prevSon = allocate<int>(numNodes);
+	flow = 0;
+}
+
+void GridGraph::addNode(int nodeIndex, int capFromSource, int capToSink)
+{
+	// as Graph::add_tweights(): keep only the difference, the common part is flow
+	int v = node(nodeIndex);
+	long long src = capFromSource, sink = capToSink;
+	if (tcap[v] > 0) src += tcap[v];
+	else sink -= tcap[v];
+	flow += (src < sink ? src : sink);
+	long long net = src - sink;
+	if (net > INT_MAX) net = INT_MAX;
+	if (net < -INT_MAX) net = -INT_MAX;
+	tcap[v] = (int)net;
+}
+
+void GridGraph::addEdge(int nodeIndexFrom, int nodeIndexTo, int capacity, int reverseCapacity)
+{
+	if (nodeIndexFrom == nodeIndexTo || (capacity == 0 && reverseCapacity == 0)) return;
+	int n = width*height;
+	if (nodeIndexFrom < n && nodeIndexTo < n) {
+		int dx = nodeIndexTo % width - nodeIndexFrom % width, dy = nodeIndexTo / width - nodeIndexFrom / width;
+		int d = (dx >= -2 && dx <= 2 && dy >= -2 && dy <= 2) ? dirOf[(dy+2)*5+dx+2] : -1;
+		if (d >= 0) {
+			rcap[(size_t)d*numGrid + node(nodeIndexFrom)] += capacity;
+			rcap[(size_t)(d^1)*numGrid + node(nodeIndexTo)] += reverseCapacity;
+			return;
+		}
+	}
+	int from = node(nodeIndexFrom), to = node(nodeIndexTo), s = 2*numExtra;
+	extraHead[s] = to; extraRcap[s] = capacity; extraRev[s] = from;
+	extraHead[s+1] = from; extraRcap[s+1] = reverseCapacity; extraRev[s+1] = to;
+	numExtra++;
+}
+
+void GridGraph::buildExtraArcs()
+{
+	if (extraSorted) return;
+	extraSorted = true;
+	// counting sort of the slots on their tail
+	int numSlots = 2*numExtra;
+	memset(firstExtra, 0, sizeof(int)*(numNodes+1));
+	for (int s=0; s<numSlots; s++) firstExtra[extraRev[s]+1]++;
+	for (int v=0; v<numNodes; v++) firstExtra[v+1] += firstExtra[v];
+	int *fill = current; // free until the trees are initialized
+	memcpy(fill, firstExtra, sizeof(int)*numNodes);
+	std::vector<int> dest(numSlots);
+	for (int s=0; s<numSlots; s++) dest[s] = fill[extraRev[s]]++;
+	// the tails are in firstExtra now, extraRev takes the sorted reverse slots
+	for (int s=0; s<numSlots; s++) extraRev[dest[s]] = dest[s^1];
+	// heads and residuals follow the cycles of the permutation in place
+	for (int s=0; s<numSlots; s++) {
+		while (dest[s] != s) {
+			int d = dest[s];
+			std::swap(extraHead[s], extraHead[d]);
+			std::swap(extraRcap[s], extraRcap[d]);
+			std::swap(dest[s], dest[d]);
+		}
+	}
+}
+
+/*
+	Augmentation with excesses as in IBFSGraph: the bridge from the source tree node v to the sink tree
+	carries its full residual capacity unless a tree root is at one end, or a path ends at a root that is
+	not on level 1 (then the path bottleneck is pushed). A tree that can not take the flow to its roots keeps
+	it as excess at the nodes whose parent arc saturates: a deficit (tcap < 0) in the source tree, a surplus
+	(tcap > 0) in the sink tree. These nodes are adopted and their excess pushed on towards the roots, from
+	the highest level down, and an orphan that is freed with excess becomes a root of the other tree.
+*/
+void GridGraph::augment(int v, int c)
+{
+	int w = head(v, c), u, a;
+	int bottleneck, bottleneckS, bottleneckT;
+	bool forceBottleneck = false;
+	bottleneck = bottleneckS = residual(v, c);
+	if (bottleneck != 1) {
+		for (u=v; parent[u] != GF_TERMINAL; u=head(u, a)) {
+			a = parent[u];
+			int r = residual(head(u, a), reverse(a));
+			if (bottleneckS > r) bottleneckS = r;
+		}
+		if (bottleneckS > tcap[u]) bottleneckS = tcap[u];
+		if (label[u] != 1) forceBottleneck = true;
+		if (u == v) bottleneck = bottleneckS;
+	}
+	if (bottleneck != 1) {
+		bottleneckT = residual(v, c);
+		for (u=w; parent[u] != GF_TERMINAL; u=head(u, a)) {
+			a = parent[u];
+			if (bottleneckT > residual(u, a)) bottleneckT = residual(u, a);
+		}
+		if (bottleneckT > -tcap[u]) bottleneckT = -tcap[u];
+		if (label[u] != -1) forceBottleneck = true;
+		if (u == w && bottleneck > bottleneckT) bottleneck = bottleneckT;
+		if (forceBottleneck) bottleneck = (bottleneckS < bottleneckT ? bottleneckS : bottleneckT);
+	}
+
+	// the flow of the bridge counts as it reaches a root, on both sides
+	residual(w, reverse(c)) += bottleneck;
+	residual(v, c) -= bottleneck;
+	flow -= bottleneck;
+	if (bottleneck == 1 || forceBottleneck) {
+		adoption<false>(augmentPath<false>(w, bottleneck), true);
+		adoption<true>(augmentPath<true>(v, bottleneck), true);
+	} else {
+		adoption<false>(augmentExcess<false>(w, bottleneck), false);
+		augmentExcesses<false>();
+		adoption<true>(augmentExcess<true>(v, bottleneck), false);
+		augmentExcesses<true>();
+	}
+}
+
+// pushes flow from node x of a tree along its path to the root, all of its arcs can take it. Nodes whose
+// parent arc saturates become orphans, parent GF_NONE until adopted. Returns the lowest orphan level.
+template <bool sTree> int GridGraph::augmentPath(int x, int push)
+{
+	std::vector<std::vector<int> > &buckets = (sTree ? orphanBucketsS : orphanBucketsT);
+	int minOrphanLevel = (sTree ? topLevelS : topLevelT) + 1;
+	for (int a; (a = parent[x]) != GF_TERMINAL; ) {
+		int p = head(x, a);
+		int &toRoot = (sTree ? residual(p, reverse(a)) : residual(x, a));
+		(sTree ? residual(x, a) : residual(p, reverse(a))) += push;
+		if ((toRoot -= push) == 0) {
+			removeSon(p, x);
+			parent[x] = GF_NONE;
+			minOrphanLevel = (sTree ? label[x] : -label[x]);
+			buckets[minOrphanLevel].push_back(x);
+		}
+		x = p;
+	}
+	tcap[x] += (sTree ? -push : push);
+	if (tcap[x] == 0) {
+		parent[x] = GF_NONE;
+		minOrphanLevel = (sTree ? label[x] : -label[x]);
+		buckets[minOrphanLevel].push_back(x);
+	}
+	flow += push;
+	return minOrphanLevel;
+}
+
+// as augmentPath(), x takes push more flow (on top of its own excess) and passes on what its parent arc
+// can take. The excess of a node that a push passes through joins the push, its bucket entry goes stale.
+template <bool sTree> int GridGraph::augmentExcess(int x, int push)
+{
+	std::vector<std::vector<int> > &buckets = (sTree ? orphanBucketsS : orphanBucketsT);
+	int &maxExcess = (sTree ? maxExcessS : maxExcessT);
+	int minOrphanLevel = (sTree ? topLevelS : topLevelT) + 1;
+	while (sTree ? tcap[x] <= 0 : tcap[x] >= 0) {
+		int a = parent[x], p = head(x, a);
+		int &toRoot = (sTree ? residual(p, reverse(a)) : residual(x, a));
+		if (toRoot < (sTree ? push - tcap[x] : push + tcap[x])) {
+			// some excess remains, x becomes an orphan
+			tcap[x] += (sTree ? toRoot - push : push - toRoot);
+			push = toRoot;
+		} else {
+			push += (sTree ? -tcap[x] : tcap[x]);
+			tcap[x] = 0;
+		}
+		(sTree ? residual(x, a) : residual(p, reverse(a))) += push;
+		if ((toRoot -= push) == 0) {
+			removeSon(p, x);
+			parent[x] = GF_NONE;
+			minOrphanLevel = (sTree ? label[x] : -label[x]);
+			buckets[minOrphanLevel].push_back(x);
+			if (tcap[x] != 0 && maxExcess < minOrphanLevel) maxExcess = minOrphanLevel;
+		}
+		x = p;
+	}
+	// the root takes what it has, the rest is its own excess
+	int root = (sTree ? tcap[x] : -tcap[x]);
+	flow += (push < root ? push : root);
+	tcap[x] += (sTree ? -push : push);
+	if (sTree ? tcap[x] <= 0 : tcap[x] >= 0) {
+		parent[x] = GF_NONE;
+		minOrphanLevel = (sTree ? label[x] : -label[x]);
+		buckets[minOrphanLevel].push_back(x);
+		if (tcap[x] != 0 && maxExcess < minOrphanLevel) maxExcess = minOrphanLevel;
+	}
+	return minOrphanLevel;
+}
+
+// pushes the excesses of a tree to its roots, the highest level first. Orphans are adopted up to the level
+// of the excesses left, the paths of which are then whole, and the rest of them at the end.
+template <bool sTree> void GridGraph::augmentExcesses()
+{
+	std::vector<std::vector<int> > &buckets = (sTree ? excessBucketsS : excessBucketsT);
+	int &maxExcess = (sTree ? maxExcessS : maxExcessT);
+	const int sign = (sTree ? 1 : -1);
+	int adoptedUpToLevel = maxExcess;
+	while (true) {
+		while (maxExcess > 0) {
+			std::vector<int> &bucket = buckets[maxExcess];
+			if (bucket.empty()) {
+				maxExcess--;
+				continue;
+			}
+			int x = bucket.back();
+			bucket.pop_back();
+			// stale: joined another push, orphaned or relabeled since
+			if (label[x] != sign*maxExcess || parent[x] < 0 || (sTree ? tcap[x] >= 0 : tcap[x] <= 0)) continue;
+			int minOrphanLevel = augmentExcess<sTree>(x, 0);
+			adoption<sTree>(minOrphanLevel <= adoptedUpToLevel ? minOrphanLevel : adoptedUpToLevel+1, false);
+			adoptedUpToLevel = maxExcess;
+		}
+		adoption<sTree>(adoptedUpToLevel+1, true);
+		if (maxExcess == 0) break;
+		adoptedUpToLevel = (sTree ? topLevelS : topLevelT);
+	}
+}
+
+// an orphan that can not be adopted is free, or with excess a root of the other tree on its top level
+template <bool sTree> void GridGraph::orphanFree(int x)
+{
+	if (tcap[x] != 0) {
+		label[x] = (sTree ? -topLevelT : topLevelS);
+		parent[x] = GF_TERMINAL;
+		current[x] = 0;
+		(sTree ? activeT1 : activeS1).push_back(x);
+	} else {
+		label[x] = 0;
+	}
+}
+
+/*
+	Adoption as in IBFSGraph: orphans are processed by increasing distance. An orphan first looks for a
+	parent one level closer to the terminal from its current arc on. Failing that, its sons (from its son
+	list) become orphans and it is relabeled to the lowest neighbor below the top level plus one, stopping
+	at the first neighbor on its own level; an orphan on the top level or without such a neighbor is freed.
+	Adopted orphans with excess go to the excess buckets. Unless toTop, levels above the excesses are left
+	for later.
+*/
+template <bool sTree> void GridGraph::adoption(int fromLevel, bool toTop)
+{
+	std::vector<std::vector<int> > &buckets = (sTree ? orphanBucketsS : orphanBucketsT);
+	std::vector<std::vector<int> > &excessBuckets = (sTree ? excessBucketsS : excessBucketsT);
+	int &maxExcess = (sTree ? maxExcessS : maxExcessT);
+	const int topLevel = (sTree ? topLevelS : topLevelT);
+	const int sign = (sTree ? 1 : -1);
+	for (int level=fromLevel; level<=topLevel && (toTop || level<=maxExcess); level++) {
+		std::vector<int> &bucket = buckets[level];
+		while (!bucket.empty()) {
+			int x = bucket.back();
+			bucket.pop_back();
+			if (sTree) numOrphansS++;
+			else numOrphansT++;
+			int n = numArcs(x);
+
+			// same level connection
+			if (level != 1) {
+				for (int k=current[x]; k<n; k++) {
+					int c = arc(x, k), y = head(x, c);
+					if (label[y] == sign*(level-1) && (sTree ? residual(y, reverse(c)) : residual(x, c)) != 0) {
+						parent[x] = c;
+						current[x] = k;
+						addSon(y, x);
+						break;
+					}
+				}
+				if (parent[x] != GF_NONE) {
+					if (tcap[x] != 0) excessBuckets[level].push_back(x);
+					continue;
+				}
+			}
+			// on the top level there is no need to relabel
+			if (level == topLevel) {
+				orphanFree<sTree>(x);
+				continue;
+			}
+			// sons become orphans, they keep their labels and stay candidates of the relabel
+			for (int y=firstSon[x]; y>=0; y=nextSon[y]) {
+				parent[y] = GF_NONE;
+				buckets[level+1].push_back(y);
+				if (tcap[y] != 0 && maxExcess < level+1) maxExcess = level+1;
+			}
+			firstSon[x] = -1;
+			int minLabel = topLevel, minK = GF_NONE;
+			for (int k=0; k<n; k++) {
+				int c = arc(x, k), y = head(x, c), l = sign*label[y];
+				if (l > 0 && l < minLabel && (sTree ? residual(y, reverse(c)) : residual(x, c)) != 0) {
+					minLabel = l;
+					minK = k;
+					if (l == level) break; // no lower neighbor is left after the same level search
+				}
+			}
+			if (minK == GF_NONE) {
+				orphanFree<sTree>(x);
+				continue;
+			}
+			label[x] = sign*(minLabel+1);
+			parent[x] = arc(x, minK);
+			current[x] = minK;
+			addSon(head(x, parent[x]), x);
+			if (minLabel+1 == topLevel) (sTree ? activeS1 : activeT1).push_back(x);
+			if (tcap[x] != 0) {
+				excessBuckets[minLabel+1].push_back(x);
+				if (maxExcess < minLabel+1) maxExcess = minLabel+1;
+			}
+		}
+	}
+}
+
+// scans the nodes of the previous level of a tree, free neighbors form the new top level
+template <bool sTree> void GridGraph::growth()
+{
+	const int level = (sTree ? topLevelS-1 : -(topLevelT-1));
+	std::vector<int> &active1 = (sTree ? activeS1 : activeT1);
+	for (size_t i=0; i<active0.size(); i++) {
+		int x = active0[i];
+		if (label[x] != level) continue; // relabeled or freed since
+		int n = numArcs(x);
+		for (int k=0; k<n; k++) {
+			int c = arc(x, k), y = head(x, c);
+			// neighbors in the same tree first, they are the most frequent in a grid
+			if ((sTree ? label[y] > 0 : label[y] < 0) || (sTree ? residual(x, c) : residual(y, reverse(c))) == 0) continue;
+			if (label[y] == 0) {
+				label[y] = (sTree ? level+1 : level-1);
+				parent[y] = reverse(c);
+				current[y] = 0;
+				addSon(x, y);
+				active1.push_back(y);
+			} else {
+				if (sTree) augment(x, c);
+				else augment(y, reverse(c));
+				if (label[x] != level) break;
+				// the same arc again while it is residual
+				if ((sTree ? residual(x, c) : residual(y, reverse(c))) != 0) k--;
+			}
+		}
+	}
+}
+
+long long GridGraph::computeMaxFlow()
+{
+	buildExtraArcs();
+	activeS1.clear();
+	activeT1.clear();
+	for (int v=0; v<numNodes; v++) {
+		current[v] = 0;
+		label[v] = 0;
+		parent[v] = GF_NONE;
+		firstSon[v] = -1;
+		if (tcap[v] != 0) {
+			label[v] = (tcap[v] > 0 ? 1 : -1);
+			parent[v] = GF_TERMINAL;
+			(tcap[v] > 0 ? activeS1 : activeT1).push_back(v);
+		}
+	}
+	topLevelS = topLevelT = 1;
+	numOrphansS = numOrphansT = 0;
+	maxExcessS = maxExcessT = 0;
+
+	// one BFS level of one tree per pass, the tree with fewer orphans so far grows; the trees are grown
+	// until both are closed, so that free nodes go to the source side of the minimum cut
+	bool dirS = true;
+	while (!activeS1.empty() || !activeT1.empty()) {
+		if (activeT1.empty()) dirS = true;
+		else if (activeS1.empty()) dirS = false;
+		else dirS = (numOrphansS < numOrphansT || (numOrphansS == numOrphansT && !dirS));
+		if (dirS) {
+			active0.swap(activeS1);
+			topLevelS++;
+		} else {
+			active0.swap(activeT1);
+			topLevelT++;
+		}
+		(dirS ? activeS1 : activeT1).clear();
+		size_t numLevels = (topLevelS > topLevelT ? topLevelS : topLevelT) + 2;
+		if (orphanBucketsS.size() < numLevels) {
+			orphanBucketsS.resize(numLevels);
+			orphanBucketsT.resize(numLevels);
+			excessBucketsS.resize(numLevels);
+			excessBucketsT.resize(numLevels);
+		}
+		if (dirS) growth<true>();
+		else growth<false>();
+	}
+	return flow;
+}
+
+int GridGraph::getNodeSides(unsigned char *mask, int first, int last,
+	unsigned char srcValue, unsigned char sinkValue) const
+{
+	int numBlocks = (last-first+GF_EXPORT_BLOCK-1)/GF_EXPORT_BLOCK;
+	int numSrc = 0;
+	#pragma omp parallel for reduction(+:numSrc) schedule(static) if(numBlocks > 1)
+	for (int b=0; b<numBlocks; b++) {
+		int begin = first + b*GF_EXPORT_BLOCK;
+		int end = (last-begin > GF_EXPORT_BLOCK ? begin+GF_EXPORT_BLOCK : last);
+		int src = 0;
+		for (int i=begin; i<end; i++) {
+			bool onSrc = isNodeOnSrcSide(i);
+			mask[i-first] = (onSrc ? srcValue : sinkValue);
+			src += onSrc;
+		}
+		numSrc += src;
+	}
+	return numSrc;
+}
+
+int GridGraph::getNodeSidesPacked(unsigned char *bits, int first, int last) const
+{
+	int numBlocks = (last-first+GF_EXPORT_BLOCK-1)/GF_EXPORT_BLOCK;
+	int numSrc = 0;
+	#pragma omp parallel for reduction(+:numSrc) schedule(static) if(numBlocks > 1)
+	for (int b=0; b<numBlocks; b++) {
+		int begin = first + b*GF_EXPORT_BLOCK;
+		int end = (last-begin > GF_EXPORT_BLOCK ? begin+GF_EXPORT_BLOCK : last);
+		int src = 0;
+		for (int i=begin; i<end; i+=8) {
+			int count = (end-i < 8 ? end-i : 8);
+			unsigned char byte = 0;
+			for (int k=0; k<count; k++) if (isNodeOnSrcSide(i+k)) byte |= (1 << k);
+			bits[(i-first)>>3] = byte;
+			src += __builtin_popcount(byte);
+		}
+		numSrc += src;
+	}
+	return numSrc;
+}
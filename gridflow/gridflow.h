@@ -0,0 +1,177 @@
+/*
+	GridGraph - maximum s-t flow / minimum s-t cut for pixel grids with implicit neighbor arcs
+
+	A grid-specialized graph in the spirit of GridCut
+		"Cache-efficient Graph Cuts on Structured Grids"
+		Ondrej Jamriska, Daniel Sykora and Alexander Hornung
+		In IEEE Conference on Computer Vision and Pattern Recognition, CVPR 2012
+	with the incremental breadth-first search of IBFSGraph on top.
+
+	The nodes x+y*width of a width x height grid have no arc lists: the neighbor in direction d is a fixed
+	shift, computed arithmetically, and the reverse arc of direction d is direction d^1 of the neighbor.
+	Only residual capacities are stored, one plane of ints per direction. Nodes are ordered in 8x8 blocks,
+	so neighbors are mostly in the same block (a few cache lines), and the grid is padded by two ghost
+	pixels on every side so that no neighbor computation needs a bounds check. Extra nodes (the color bins
+	of OneCut) are numbered width*height+k and connected by explicit edges, as are all node pairs that are
+	not grid neighbors.
+
+	The search is that of IBFSGraph with its excesses: the source and sink trees grow one breadth-first
+	level at a time, a bridge between them pushes its full capacity and what a tree can not pass on to its
+	roots stays as excess at nodes that are adopted and push it on later. Orphans are adopted level by
+	level, from a current arc on, with son lists so that a relabel does not scan for the sons. The 3-pass
+	adoption of IBFSGraph is left out, on the sample it does not make IBFSGraph any faster. The trees are
+	grown until both are closed, free nodes are on the source side, as IBFSSolver reads IBFSGraph.
+
+	Capacities are ints as in IBFSGraph, the flow is a long long.
+
+		GridGraph g;
+		g.initSize(width, height, 8, numExtraNodes, numExtraEdges);
+		g.addNode(x+y*width, capFromSource, capToSink);
+		g.addEdge(x+y*width, (x+1)+y*width, capacity, reverseCapacity); // into the planes
+		g.addEdge(x+y*width, width*height+k, capacity, reverseCapacity); // explicit
+		long long flow = g.computeMaxFlow();
+		bool obj = g.isNodeOnSrcSide(x+y*width);
+*/
+
+#ifndef _GRIDFLOW_H__
+#define _GRIDFLOW_H__
+
+#include <stddef.h>
+#include <vector>
+#include "../MemArena.h"
+
+class GridGraph
+{
+public:
+	// with an arena all arrays are drawn from it and released with it
+	GridGraph(MemArena *a_arena = NULL);
+	~GridGraph();
+
+	// connectivity 4, 8 or 16 (the neighborhoods of OneCut), numExtraEdges bounds the edges that are not
+	// between grid neighbors
+	void initSize(int width, int height, int connectivity, int numExtraNodes, int numExtraEdges);
+	// number of grid neighbor pairs, i.e. the edges of a full grid that go into the planes
+	static long long getNumGridEdges(int width, int height, int connectivity);
+
+	// capacities are added to the t-links of the node
+	void addNode(int nodeIndex, int capFromSource, int capToSink);
+	// capacities of an edge between grid neighbors are added to the planes, other edges are explicit, all
+	// before computeMaxFlow()
+	void addEdge(int nodeIndexFrom, int nodeIndexTo, int capacity, int reverseCapacity);
+
+	long long computeMaxFlow();
+	inline long long getFlow() const {
+		return flow;
+	}
+	// after computeMaxFlow(): nodes that are not in the sink tree, i.e. can not reach the sink
+	inline bool isNodeOnSrcSide(int nodeIndex) const {
+		return label[node(nodeIndex)] >= 0;
+	}
+	// bulk isNodeOnSrcSide() for the nodes [first,last), as IBFSGraph::getNodeSides(). Returns the number
+	// of source side nodes.
+	int getNodeSides(unsigned char *mask, int first, int last,
+		unsigned char srcValue = 1, unsigned char sinkValue = 0) const;
+	// as above, one bit per node: bit (i-first)&7 of bits[(i-first)>>3] is set for source side nodes
+	int getNodeSidesPacked(unsigned char *bits, int first, int last) const;
+	// bytes of all arrays of the graph, without the active lists and the buckets of computeMaxFlow()
+	inline size_t getBytes() const {
+		return bytes;
+	}
+
+private:
+	enum {GF_NONE = -1, GF_TERMINAL = -2};
+
+	MemArena *arena;
+	int width, height, numDirs;
+	int blocksX, numGrid, numNodes; // grid nodes [0,numGrid) including ghosts, extra nodes after
+	int numExtra, maxExtra;
+	long long flow;
+	size_t bytes;
+	int shiftX[16], shiftY[16];
+	int dirOf[25]; // direction of the shift (dx,dy) at (dy+2)*5+dx+2, -1 if none
+
+	// residual capacity of direction d of grid node v is rcap[d*numGrid+v]
+	int *rcap;
+	int *tcap; // residual t-link or excess: >0 to the source, <0 to the sink
+	// explicit arcs, numDirs+s is the arc code of slot s: head extraHead[s], residual capacity extraRcap[s],
+	// reverse slot extraRev[s]. Edge e is added as the slots 2e and 2e+1 with their tails in extraRev,
+	// computeMaxFlow() sorts the slots by tail so that the arcs of node v are [firstExtra[v],firstExtra[v+1])
+	// as in IBFSGraph, one contiguous run per hub.
+	int *extraHead, *extraRcap, *extraRev;
+	int *firstExtra;
+	bool extraSorted;
+
+	// search trees: label is the distance to the source (>0) or minus the distance to the sink (<0), 0 for
+	// free nodes, roots with excess may be on any level. parent is the arc from v to its parent (arc codes below numDirs are directions), current is
+	// the index of the arc the parent search of v resumes from.
+	int *label, *parent, *current;
+	// sons of every tree node as a doubly linked list, -1 terminated
+	int *firstSon, *nextSon, *prevSon;
+	int topLevelS, topLevelT;
+	std::vector<int> active0, activeS1, activeT1;
+	std::vector<std::vector<int> > orphanBucketsS, orphanBucketsT; // orphans by distance to the terminal
+	long long numOrphansS, numOrphansT;
+	// nodes with excess to push to the roots by level (entries go stale), the highest level that has some
+	std::vector<std::vector<int> > excessBucketsS, excessBucketsT;
+	int maxExcessS, maxExcessT;
+
+	template <class T> T* allocate(size_t n);
+	template <class T> void release(T *p);
+	void buildExtraArcs();
+
+	inline int node(int nodeIndex) const {
+		if (nodeIndex >= width*height) return numGrid + nodeIndex - width*height;
+		return gridNode(nodeIndex % width, nodeIndex / width);
+	}
+	inline int gridNode(int x, int y) const {
+		x += 2; y += 2;
+		return (((y >> 3)*blocksX + (x >> 3)) << 6) | ((y & 7) << 3) | (x & 7);
+	}
+	// neighbor of grid node v in direction d, across blocks without a branch
+	inline int neighbor(int v, int d) const {
+		int ix = v & 7, iy = (v >> 3) & 7;
+		int nx = ix + shiftX[d], ny = iy + shiftY[d];
+		return v + ((((ny >> 3)*blocksX + (nx >> 3)) << 6) + (((ny & 7) - iy) << 3) + (nx & 7) - ix);
+	}
+	inline int head(int v, int c) const {
+		return (c < numDirs) ? neighbor(v, c) : extraHead[c - numDirs];
+	}
+	// reverse arc of arc c, direction d^1 of the neighbor for the grid
+	inline int reverse(int c) const {
+		return (c < numDirs) ? (c ^ 1) : numDirs + extraRev[c - numDirs];
+	}
+	// residual capacity of arc c of node v
+	inline int & residual(int v, int c) {
+		return (c < numDirs) ? rcap[(size_t)c*numGrid + v] : extraRcap[c - numDirs];
+	}
+	inline int numArcs(int v) const {
+		return (v < numGrid ? numDirs : 0) + firstExtra[v+1] - firstExtra[v];
+	}
+	// k-th arc of node v
+	inline int arc(int v, int k) const {
+		int g = (v < numGrid ? numDirs : 0);
+		return (k < g) ? k : numDirs + firstExtra[v] + k - g;
+	}
+
+	inline void addSon(int p, int y) {
+		nextSon[y] = firstSon[p];
+		prevSon[y] = -1;
+		if (firstSon[p] >= 0) prevSon[firstSon[p]] = y;
+		firstSon[p] = y;
+	}
+	inline void removeSon(int p, int y) {
+		if (prevSon[y] >= 0) nextSon[prevSon[y]] = nextSon[y];
+		else firstSon[p] = nextSon[y];
+		if (nextSon[y] >= 0) prevSon[nextSon[y]] = prevSon[y];
+	}
+
+	void augment(int v, int c);
+	template <bool sTree> int augmentPath(int x, int push);
+	template <bool sTree> int augmentExcess(int x, int push);
+	template <bool sTree> void augmentExcesses();
+	template <bool sTree> void orphanFree(int x);
+	template <bool sTree> void growth();
+	template <bool sTree> void adoption(int fromLevel, bool toTop);
+};
+
+#endif
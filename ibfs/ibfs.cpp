@@ -61,10 +61,11 @@ If you require another license, please contact the above.
 	}
 
 
-IBFSGraph::IBFSGraph(IBFSInitMode a_initMode)
+IBFSGraph::IBFSGraph(IBFSInitMode a_initMode, MemArena *a_arena)
 :prNodeBuckets(orphan3PassBuckets)
 {
 	initMode = a_initMode;
+	arena = a_arena;
 	arcIter = NULL;
 	incList = NULL;
 	incLen = incIteration = 0;
@@ -90,8 +91,10 @@ IBFSGraph::IBFSGraph(IBFSInitMode a_initMode)
 
 IBFSGraph::~IBFSGraph()
 {
-	delete []nodes;
-	delete []memArcs;
+	if (arena == NULL) {
+		delete []nodes;
+		delete []memArcs;
+	}
 	orphanBuckets.free();
 	orphan3PassBuckets.free();
 	excessBuckets.free();
@@ -105,6 +108,9 @@ void IBFSGraph::initGraph()
 		initGraphFast();
 	} else if (initMode == IB_INIT_COMPACT) {
 		initGraphCompact();
+	} else if (initMode == IB_INIT_DIRECT) {
+		for (Node *x=nodes; x != nodeEnd; x++) x->parent = NULL;
+		initNodes();
 	}
 	topLevelS = topLevelT = 1;
 }
@@ -114,14 +120,14 @@ void IBFSGraph::initSize(int numNodes, int numEdges)
 {
 	// compute allocation size
 	unsigned long long arcTmpMemsize = (unsigned long long)sizeof(TmpEdge)*(unsigned long long)numEdges;
-	unsigned long long arcRealMemsize = (unsigned long long)sizeof(Arc)*(unsigned long long)(numEdges*2);
+	unsigned long long arcRealMemsize = (unsigned long long)sizeof(Arc)*2*(unsigned long long)numEdges;
 	unsigned long long nodeMemsize = (unsigned long long)sizeof(Node**)*(unsigned long long)(numNodes*3) +
 			(IB_EXCESSES ? ((unsigned long long)sizeof(Node**)*(unsigned long long)(numNodes*2)) : 0);
 	unsigned long long arcMemsize = 0;
 	if (initMode == IB_INIT_FAST) {
 		arcMemsize = arcRealMemsize + arcTmpMemsize;
 	} else if (initMode == IB_INIT_COMPACT) {
-		arcTmpMemsize += (unsigned long long)sizeof(TmpArc)*(unsigned long long)(numEdges*2);
+		arcTmpMemsize += (unsigned long long)sizeof(TmpArc)*2*(unsigned long long)numEdges;
 		arcMemsize = arcTmpMemsize;
 	}
 	if (arcMemsize < (arcRealMemsize + nodeMemsize)) {
@@ -133,17 +139,17 @@ void IBFSGraph::initSize(int numNodes, int numEdges)
 		fprintf(stdout, "c allocating arcs... \t [%lu MB]\n", (unsigned long)arcMemsize/(1<<20));
 		fflush(stdout);
 	}
-	memArcs = new char[arcMemsize];
+	memArcs = (arena != NULL ? arena->alloc<char>(arcMemsize) : new char[arcMemsize]);
 	memset(memArcs, 0, (unsigned long long)sizeof(char)*arcMemsize);
 	if (initMode == IB_INIT_FAST) {
 		tmpEdges = (TmpEdge*)(memArcs + arcRealMemsize);
 	} else if (initMode == IB_INIT_COMPACT) {
 		tmpEdges = (TmpEdge*)(memArcs);
-		tmpArcs = (TmpArc*)(memArcs +arcMemsize -(unsigned long long)sizeof(TmpArc)*(unsigned long long)(numEdges*2));
+		tmpArcs = (TmpArc*)(memArcs +arcMemsize -(unsigned long long)sizeof(TmpArc)*2*(unsigned long long)numEdges);
 	}
 	tmpEdgeLast = tmpEdges; // will advance as edges are added
 	arcs = (Arc*)memArcs;
-	arcEnd = arcs + numEdges*2;
+	arcEnd = arcs + 2*(long long)numEdges;
 
 	// allocate nodes
 //	if (verbose) {
@@ -151,7 +157,7 @@ void IBFSGraph::initSize(int numNodes, int numEdges)
 //		fflush(stdout);
 //	}
 	this->numNodes = numNodes;
-	nodes = new Node[numNodes+1];
+	nodes = (arena != NULL ? arena->alloc<Node>(numNodes+1) : new Node[numNodes+1]);
 	memset(nodes, 0, sizeof(Node)*(numNodes+1));
 	nodeEnd = nodes+numNodes;
 	active0.init((Node**)(arcEnd));
@@ -159,10 +165,10 @@ void IBFSGraph::initSize(int numNodes, int numEdges)
 	activeT1.init((Node**)(arcEnd) + (2*numNodes));
 	if (IB_EXCESSES) {
 		ptrs = (Node**)(arcEnd) + (3*numNodes);
-		excessBuckets.init(nodes, ptrs, numNodes);
+		excessBuckets.init(nodes, ptrs, numNodes, arena);
 	}
-	orphan3PassBuckets.init(nodes, numNodes);
-	orphanBuckets.init(nodes, numNodes);
+	orphan3PassBuckets.init(nodes, numNodes, arena);
+	orphanBuckets.init(nodes, numNodes, arena);
 
 	// init members
 	flow = 0;
@@ -175,11 +181,22 @@ void IBFSGraph::initSize(int numNodes, int numEdges)
 }
 
 
+void IBFSGraph::initArcs()
+{
+	// first arc of every node from the degrees, the arcs are filled from there on
+	nodes->firstArc = arcs;
+	for (Node *x=nodes; x != nodeEnd; x++) {
+		(x+1)->firstArc = x->firstArc + x->label;
+		x->parent = x->firstArc;
+		x->label = 0;
+	}
+}
+
 void IBFSGraph::initNodes()
 {
 	Node *x;
 	for (x=nodes; x <= nodeEnd; x++) {
-		x->firstArc = (arcs + x->label);
+		if (initMode != IB_INIT_DIRECT) x->firstArc = (arcs + x->label);
 		if (x->excess == 0) {
 			x->label = 0;
 			continue;
@@ -929,17 +946,17 @@ template<bool sTree> void IBFSGraph::augmentIncrements()
 }
 
 
-int IBFSGraph::computeMaxFlow()
+long long IBFSGraph::computeMaxFlow()
 {
 	return computeMaxFlow(true, false);
 }
 
-int IBFSGraph::computeMaxFlow(bool allowIncrements)
+long long IBFSGraph::computeMaxFlow(bool allowIncrements)
 {
 	return computeMaxFlow(true, allowIncrements);
 }
 
-int IBFSGraph::computeMaxFlow(bool initialDirS, bool allowIncrements)
+long long IBFSGraph::computeMaxFlow(bool initialDirS, bool allowIncrements)
 {
 	// incremental?
 	if (incIteration >= 1 && incList != NULL) {
@@ -977,7 +994,7 @@ int IBFSGraph::computeMaxFlow(bool initialDirS, bool allowIncrements)
 		else growth<false>();
 		if (IBTEST) {
 			testTree();
-			fprintf(stdout, "dirS=%d aug=%d   S %d / T %d   flow=%d\n",
+			fprintf(stdout, "dirS=%d aug=%d   S %d / T %d   flow=%lld\n",
 					dirS, augTimestamp, uniqOrphansS, uniqOrphansT, flow);
 			fflush(stdout);
 		}
@@ -1001,6 +1018,59 @@ int IBFSGraph::computeMaxFlow(bool initialDirS, bool allowIncrements)
 ///////////////////////////////////////////////////
 // experimental min marginals
 ///////////////////////////////////////////////////
+// nodes per block of the bulk label export, a multiple of 8 so that packed blocks do not share bytes
+#define IB_EXPORT_BLOCK (1<<16)
+
+int IBFSGraph::getNodeSides(unsigned char *mask, int first, int last, bool freeOnSrcSide,
+	unsigned char srcValue, unsigned char sinkValue)
+{
+	int numBlocks = (last-first+IB_EXPORT_BLOCK-1)/IB_EXPORT_BLOCK;
+	int numSrc = 0;
+	#pragma omp parallel for reduction(+:numSrc) schedule(static) if(numBlocks > 1)
+	for (int b=0; b<numBlocks; b++)
+	{
+		int begin = first + b*IB_EXPORT_BLOCK;
+		int end = (last-begin > IB_EXPORT_BLOCK ? begin+IB_EXPORT_BLOCK : last);
+		int src = 0;
+		for (int i=begin; i<end; i++)
+		{
+			int label = nodes[i].label;
+			int onSrc = (label > 0 || (label == 0 && freeOnSrcSide));
+			mask[i-first] = (onSrc ? srcValue : sinkValue);
+			src += onSrc;
+		}
+		numSrc += src;
+	}
+	return numSrc;
+}
+
+int IBFSGraph::getNodeSidesPacked(unsigned char *bits, int first, int last, bool freeOnSrcSide)
+{
+	int numBlocks = (last-first+IB_EXPORT_BLOCK-1)/IB_EXPORT_BLOCK;
+	int numSrc = 0;
+	#pragma omp parallel for reduction(+:numSrc) schedule(static) if(numBlocks > 1)
+	for (int b=0; b<numBlocks; b++)
+	{
+		int begin = first + b*IB_EXPORT_BLOCK;
+		int end = (last-begin > IB_EXPORT_BLOCK ? begin+IB_EXPORT_BLOCK : last);
+		int src = 0;
+		for (int i=begin; i<end; i+=8)
+		{
+			int n = (end-i < 8 ? end-i : 8);
+			unsigned char byte = 0;
+			for (int k=0; k<n; k++)
+			{
+				int label = nodes[i+k].label;
+				if (label > 0 || (label == 0 && freeOnSrcSide)) byte |= (1 << k);
+			}
+			bits[(i-first)>>3] = byte;
+			src += __builtin_popcount(byte);
+		}
+		numSrc += src;
+	}
+	return numSrc;
+}
+
 void IBFSGraph::computeMinMarginals()
 {
 	int *srcSide;
@@ -1047,7 +1117,7 @@ void IBFSGraph::computeMinMarginals()
 //	}
 //	topLevelS=1;
 
-	int flowCopy = flow;
+	long long flowCopy = flow;
 //	int topLevelSCopy = topLevelS;
 //	int topLevelTCopy = topLevelT;
 //	memcpy(arcsCopy, arcs, sizeof(Arc)*(arcEnd-arcs));
@@ -1073,7 +1143,7 @@ void IBFSGraph::computeMinMarginals()
 		}
 		if (srcSide[nodeIndex]) incNode(nodeIndex, 0, infCap);
 		else incNode(nodeIndex, infCap, 0);
-		int flowDiff = computeMaxFlow(false, !srcSide[nodeIndex])-flowCopy;
+		long long flowDiff = computeMaxFlow(false, !srcSide[nodeIndex])-flowCopy;
 		if (flowDiff == infCap || flowDiff == -infCap) nEmpty++;
 //		testTree();
 
@@ -1103,7 +1173,7 @@ void IBFSGraph::computeMinMarginals()
 				if (x->label > 0 && x->label < minLabelS) minLabelS = x->label;
 				else if (x->label < 0 && -x->label < minLabelT) minLabelT = -x->label;
 			}
-			fprintf(stdout, "%d (%d>%d, %d>%d, %d) ", (int)(100*incIteration/(nodeEnd-nodes)),
+			fprintf(stdout, "%d (%d>%d, %d>%d, %lld) ", (int)(100*incIteration/(nodeEnd-nodes)),
 					minLabelS, topLevelS, minLabelT, topLevelT, flow);
 			fflush(stdout);
 		}
@@ -1387,7 +1457,7 @@ void IBFSGraph::testTree()
 		}
 	}
 
-	if ((int)(testExcess - totalExcess) != (flow - testFlow)) {
+	if ((long long)(testExcess - totalExcess) != (flow - testFlow)) {
 //		IBDEBUG("ILLEGAL FLOW!");
 //		testExit();
 	}
@@ -45,6 +45,7 @@ If you require another license, please contact the above.
 
 #include <stdio.h>
 #include <string.h>
+#include "../MemArena.h"
 
 
 #define IB_BOTTLENECK_ORIG 0
@@ -130,8 +131,12 @@ private:
 class IBFSGraph
 {
 public:
-	enum IBFSInitMode { IB_INIT_FAST, IB_INIT_COMPACT };
-	IBFSGraph(IBFSInitMode initMode);
+	// IB_INIT_DIRECT keeps no edge buffer: after initSize() give the out degree of every node with
+	// addDegree() (an edge counts at both of its nodes), call initArcs(), then addEdge() writes both arcs
+	// in place. Arcs are addressed by pointers only, so their number may exceed INT_MAX.
+	enum IBFSInitMode { IB_INIT_FAST, IB_INIT_COMPACT, IB_INIT_DIRECT };
+	// if an arena is given, all arrays are drawn from it and released by arena->reset()
+	IBFSGraph(IBFSInitMode initMode, MemArena *arena = NULL);
 	~IBFSGraph();
 	void setVerbose(bool a_verbose) {
 		verbose = a_verbose;
@@ -140,6 +145,10 @@ public:
 	bool readFromFileCompile(char *filename);
 	void initSize(int numNodes, int numEdges);
 	void addEdge(int nodeIndexFrom, int nodeIndexTo, int capacity, int reverseCapacity);
+	void addDegree(int nodeIndex, int degree) {
+		nodes[nodeIndex].label += degree;
+	}
+	void initArcs();
 	void addNode(int nodeIndex, int capFromSource, int capToSink);
 	void incEdge(int nodeIndexFrom, int nodeIndexTo, int capacity, int reverseCapacity);
 	void incNode(int nodeIndex, int deltaCapFromSource, int deltaCapToSink);
@@ -147,8 +156,8 @@ public:
 	struct Arc;
 	void incArc(Arc *a, int deltaCap);
 	void initGraph();
-	int computeMaxFlow();
-	int computeMaxFlow(bool allowIncrements);
+	long long computeMaxFlow();
+	long long computeMaxFlow(bool allowIncrements);
 	void resetTrees();
 	void computeMinMarginals();
 	void pushRelabel();
@@ -160,7 +169,7 @@ public:
 	inline IBFSStats getStats() {
 		return stats;
 	}
-	inline int getFlow() {
+	inline long long getFlow() {
 		return flow;
 	}
 	inline int getNumNodes() {
@@ -170,6 +179,13 @@ public:
 		return arcEnd-arcs;
 	}
 	int isNodeOnSrcSide(int nodeIndex, int freeNodeValue = 0);
+	// bulk isNodeOnSrcSide() for the nodes [first,last): writes srcValue or sinkValue to mask[i-first],
+	// free nodes go to the source side if freeOnSrcSide. Returns the number of source side nodes.
+	// Blocks of nodes are exported in parallel when built with OpenMP.
+	int getNodeSides(unsigned char *mask, int first, int last, bool freeOnSrcSide,
+		unsigned char srcValue = 1, unsigned char sinkValue = 0);
+	// as above, one bit per node: bit (i-first)&7 of bits[(i-first)>>3] is set for source side nodes
+	int getNodeSidesPacked(unsigned char *bits, int first, int last, bool freeOnSrcSide);
 
 
 	struct Node;
@@ -210,7 +226,7 @@ private:
 	template <bool sTree> void adoption3Pass(int minBucket);
 	template <bool dirS> void growth();
 
-	int computeMaxFlow(bool trackChanges, bool initialDirS);
+	long long computeMaxFlow(bool trackChanges, bool initialDirS);
 	void resetTrees(int newTopLevelS, int newTopLevelT);
 
 	// push relabel
@@ -254,6 +270,17 @@ private:
 	};
 
 
+	// bucket arrays come from the arena if there is one
+	static inline Node** allocBuckets(MemArena *arena, int num) {
+		Node **buckets = (arena != NULL ? arena->alloc<Node*>(num) : new Node*[num]);
+		memset(buckets, 0, sizeof(Node*)*num);
+		return buckets;
+	}
+	static inline void freeBuckets(MemArena *arena, Node **buckets) {
+		if (arena == NULL) delete []buckets;
+	}
+
+
 #define IB_PREVPTR_EXCESS(x) (ptrs[(((x)-nodes)<<1) + 1])
 #define IB_NEXTPTR_EXCESS(x) (ptrs[((x)-nodes)<<1])
 #define IB_PREVPTR_3PASS(x) ((x)->firstSon)
@@ -268,29 +295,29 @@ private:
 			maxBucket = 0;
 			nodes = NULL;
 			allocLevels = 0;
+			arena = NULL;
 		}
-		inline void init(Node *a_nodes, int numNodes) {
+		inline void init(Node *a_nodes, int numNodes, MemArena *a_arena) {
 			nodes = a_nodes;
+			arena = a_arena;
 			allocLevels = numNodes/8;
 			if (allocLevels < IB_ALLOC_INIT_LEVELS) {
 				if (numNodes < IB_ALLOC_INIT_LEVELS) allocLevels = numNodes;
 				else allocLevels = IB_ALLOC_INIT_LEVELS;
 			}
-			buckets = new Node*[allocLevels+1];
-			memset(buckets, 0, sizeof(Node*)*(allocLevels+1));
+			buckets = allocBuckets(arena, allocLevels+1);
 			maxBucket = 0;
 		}
 		inline void allocate(int numLevels) {
 			if (numLevels > allocLevels) {
 				allocLevels <<= 1;
-				Node **alloc = new Node*[allocLevels+1];
-				memset(alloc, 0, sizeof(Node*)*(allocLevels+1));
-				delete []buckets;
+				Node **alloc = allocBuckets(arena, allocLevels+1);
+				freeBuckets(arena, buckets);
 				buckets = alloc;
 			}
 		}
 		inline void free() {
-			delete []buckets;
+			freeBuckets(arena, buckets);
 			buckets = NULL;
 		}
 		template <bool sTree> inline void add(Node* x) {
@@ -310,6 +337,7 @@ private:
 		int maxBucket;
 		Node *nodes;
 		int allocLevels;
+		MemArena *arena;
 	};
 
 
@@ -321,30 +349,30 @@ private:
 			buckets = NULL;
 			nodes = NULL;
 			maxBucket = allocLevels = -1;
+			arena = NULL;
 		}
-		inline void init(Node *a_nodes, int numNodes) {
+		inline void init(Node *a_nodes, int numNodes, MemArena *a_arena) {
 			nodes = a_nodes;
+			arena = a_arena;
 			allocLevels = numNodes/8;
 			if (allocLevels < IB_ALLOC_INIT_LEVELS) {
 				if (numNodes < IB_ALLOC_INIT_LEVELS) allocLevels = numNodes;
 				else allocLevels = IB_ALLOC_INIT_LEVELS;
 			}
-			buckets = new Node*[allocLevels+1];
-			memset(buckets, 0, sizeof(Node*)*(allocLevels+1));
+			buckets = allocBuckets(arena, allocLevels+1);
 			maxBucket = 0;
 		}
 		inline void allocate(int numLevels) {
 			if (numLevels > allocLevels) {
 				allocLevels <<= 1;
-				Node **alloc = new Node*[allocLevels+1];
-				memset(alloc, 0, sizeof(Node*)*(allocLevels+1));
+				Node **alloc = allocBuckets(arena, allocLevels+1);
 				//memcpy(alloc, buckets, sizeof(Node*)*(allocLevels+1));
-				delete []buckets;
+				freeBuckets(arena, buckets);
 				buckets = alloc;
 			}
 		}
 		inline void free() {
-			delete []buckets;
+			freeBuckets(arena, buckets);
 			buckets = NULL;
 		}
 		template <bool sTree> inline void add(Node* x) {
@@ -378,6 +406,7 @@ private:
 		int maxBucket;
 		Node *nodes;
 		int allocLevels;
+		MemArena *arena;
 	};
 
 	class ExcessBuckets
@@ -387,31 +416,31 @@ private:
 			buckets = ptrs = NULL;
 			nodes = NULL;
 			allocLevels = maxBucket = minBucket = -1;
+			arena = NULL;
 		}
-		inline void init(Node *a_nodes, Node **a_ptrs, int numNodes) {
+		inline void init(Node *a_nodes, Node **a_ptrs, int numNodes, MemArena *a_arena) {
 			nodes = a_nodes;
+			arena = a_arena;
 			allocLevels = numNodes/8;
 			if (allocLevels < IB_ALLOC_INIT_LEVELS) {
 				if (numNodes < IB_ALLOC_INIT_LEVELS) allocLevels = numNodes;
 				else allocLevels = IB_ALLOC_INIT_LEVELS;
 			}
-			buckets = new Node*[allocLevels+1];
-			memset(buckets, 0, sizeof(Node*)*(allocLevels+1));
+			buckets = allocBuckets(arena, allocLevels+1);
 			ptrs = a_ptrs;
 			reset();
 		}
 		inline void allocate(int numLevels) {
 			if (numLevels > allocLevels) {
 				allocLevels <<= 1;
-				Node **alloc = new Node*[allocLevels+1];
-				memset(alloc, 0, sizeof(Node*)*(allocLevels+1));
+				Node **alloc = allocBuckets(arena, allocLevels+1);
 				//memcpy(alloc, buckets, sizeof(Node*)*(allocLevels+1));
-				delete []buckets;
+				freeBuckets(arena, buckets);
 				buckets = alloc;
 			}
 		}
 		inline void free() {
-			delete []buckets;
+			freeBuckets(arena, buckets);
 			buckets = NULL;
 		}
 
@@ -457,6 +486,7 @@ private:
 		int minBucket;
 		Node *nodes;
 		int allocLevels;
+		MemArena *arena;
 	};
 
 	// members
@@ -465,7 +495,7 @@ private:
 	Arc		*arcs, *arcEnd;
 	Node	**ptrs;
 	int 	numNodes;
-	int		flow;
+	long long	flow;
 	short 	augTimestamp;
 	int topLevelS, topLevelT;
 	ActiveList active0, activeS1, activeT1;
@@ -481,7 +511,7 @@ private:
 	bool fileIsCompiled;
 	bool fileHasMore;
 	bool verbose;
-	int testFlow;
+	long long testFlow;
 	double testExcess;
 
 	//
@@ -515,6 +545,7 @@ private:
 		int			cap;
 	};
 	char	*memArcs;
+	MemArena *arena;
 	TmpEdge	*tmpEdges, *tmpEdgeLast;
 	TmpArc	*tmpArcs;
 	bool isInitializedGraph() {
@@ -690,6 +721,20 @@ inline void IBFSGraph::incArc(Arc *a, int deltaCap)
 
 inline void IBFSGraph::addEdge(int nodeIndexFrom, int nodeIndexTo, int capacity, int reverseCapacity)
 {
+	if (initMode == IB_INIT_DIRECT) {
+		// parent is the next free arc of the node until initGraph()
+		Node *x = nodes+nodeIndexFrom, *y = nodes+nodeIndexTo;
+		Arc *a = (x->parent)++, *b = (y->parent)++;
+		a->head = y;
+		a->rev = b;
+		a->rCap = capacity;
+		a->isRevResidual = (reverseCapacity != 0);
+		b->head = x;
+		b->rev = a;
+		b->rCap = reverseCapacity;
+		b->isRevResidual = (capacity != 0);
+		return;
+	}
 	tmpEdgeLast->tail = nodeIndexFrom;
 	tmpEdgeLast->head = nodeIndexTo;
 	tmpEdgeLast->cap = capacity;
@@ -28,10 +28,12 @@ int main(int argc, char * argv[])
 	outs("load bounding box");
 	Table2D<int> box = loadImage<RGB>("images/326038_box.bmp");
 	
-	onecut.constructbkgraph(box, WeightPotts);
+	onecut.constructbkgraph(std::move(box), WeightPotts); // box is handed over, not copied
 
 	outs("run maxflow/mincut");
 	Table2D<Label> segmentation = onecut.run();
+	double flow = onecut.getflow();
+	outv(flow);
 
 	outs("save segmentation");
 	savebinarylabeling(image, segmentation, "images/326038_result.bmp");
@@ -41,7 +43,7 @@ int main(int argc, char * argv[])
 
 	// segmentation error rate
 	Table2D<int> groundtruth = loadImage<RGB>("images/326038_gt.bmp"); // ground truth
-	double errorrate = geterrorrate(segmentation, groundtruth, countintable(box, 0));
+	double errorrate = geterrorrate(segmentation, groundtruth, onecut.getboxstats().boxsize);
 	outv(errorrate);
 
 	return -1;
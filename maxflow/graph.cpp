@@ -8,16 +8,25 @@
 
 
 template <typename captype, typename tcaptype, typename flowtype> 
-	Graph<captype, tcaptype, flowtype>::Graph(int node_num_max, int edge_num_max, void (*err_function)(char *))
+	Graph<captype, tcaptype, flowtype>::Graph(int node_num_max, int edge_num_max, void (*err_function)(char *), MemArena *_arena)
 	: node_num(0),
 	  nodeptr_block(NULL),
+	  arena(_arena),
 	  error_function(err_function)
 {
 	if (node_num_max < 16) node_num_max = 16;
 	if (edge_num_max < 16) edge_num_max = 16;
 
-	nodes = (node*) malloc(node_num_max*sizeof(node));
-	arcs = (arc*) malloc(2*edge_num_max*sizeof(arc));
+	if (arena)
+	{
+		nodes = arena->alloc<node>(node_num_max);
+		arcs = arena->alloc<arc>(2*edge_num_max);
+	}
+	else
+	{
+		nodes = (node*) malloc(node_num_max*sizeof(node));
+		arcs = (arc*) malloc(2*edge_num_max*sizeof(arc));
+	}
 	if (!nodes || !arcs) { if (error_function) (*error_function)("Not enough memory!"); exit(1); }
 
 	node_last = nodes;
@@ -37,8 +46,11 @@ template <typename captype, typename tcaptype, typename flowtype>
 		delete nodeptr_block; 
 		nodeptr_block = NULL; 
 	}
-	free(nodes);
-	free(arcs);
+	if (!arena)
+	{
+		free(nodes);
+		free(arcs);
+	}
 }
 
 template <typename captype, typename tcaptype, typename flowtype> 
@@ -66,7 +78,13 @@ template <typename captype, typename tcaptype, typename flowtype>
 
 	node_num_max += node_num_max / 2;
 	if (node_num_max < node_num + num) node_num_max = node_num + num;
-	nodes = (node*) realloc(nodes_old, node_num_max*sizeof(node));
+	if (arena)
+	{
+		// the old array stays in the arena until it is reset
+		nodes = arena->alloc<node>(node_num_max);
+		memcpy(nodes, nodes_old, node_num*sizeof(node));
+	}
+	else nodes = (node*) realloc(nodes_old, node_num_max*sizeof(node));
 	if (!nodes) { if (error_function) (*error_function)("Not enough memory!"); exit(1); }
 
 	node_last = nodes + node_num;
@@ -90,7 +108,12 @@ template <typename captype, typename tcaptype, typename flowtype>
 	arc* arcs_old = arcs;
 
 	arc_num_max += arc_num_max / 2; if (arc_num_max & 1) arc_num_max ++;
-	arcs = (arc*) realloc(arcs_old, arc_num_max*sizeof(arc));
+	if (arena)
+	{
+		arcs = arena->alloc<arc>(arc_num_max);
+		memcpy(arcs, arcs_old, arc_num*sizeof(arc));
+	}
+	else arcs = (arc*) realloc(arcs_old, arc_num_max*sizeof(arc));
 	if (!arcs) { if (error_function) (*error_function)("Not enough memory!"); exit(1); }
 
 	arc_last = arcs + arc_num;
@@ -112,4 +135,57 @@ template <typename captype, typename tcaptype, typename flowtype>
 	}
 }
 
+// nodes per block of the bulk segment export, a multiple of 8 so that packed blocks do not share bytes
+#define SEGMENT_EXPORT_BLOCK (1<<16)
+
+template <typename captype, typename tcaptype, typename flowtype> 
+	int Graph<captype,tcaptype,flowtype>::get_segments(unsigned char* mask, node_id first, node_id last, termtype default_segm,
+		unsigned char source_value, unsigned char sink_value)
+{
+	int block_num = (last-first+SEGMENT_EXPORT_BLOCK-1)/SEGMENT_EXPORT_BLOCK;
+	int source_num = 0;
+	#pragma omp parallel for reduction(+:source_num) schedule(static) if(block_num > 1)
+	for (int b=0; b<block_num; b++)
+	{
+		node_id begin = first + b*SEGMENT_EXPORT_BLOCK;
+		node_id end = (last-begin > SEGMENT_EXPORT_BLOCK) ? begin+SEGMENT_EXPORT_BLOCK : last;
+		int source = 0;
+		for (node_id i=begin; i<end; i++)
+		{
+			int is_source = nodes[i].parent ? !nodes[i].is_sink : (default_segm == SOURCE);
+			mask[i-first] = is_source ? source_value : sink_value;
+			source += is_source;
+		}
+		source_num += source;
+	}
+	return source_num;
+}
+
+template <typename captype, typename tcaptype, typename flowtype> 
+	int Graph<captype,tcaptype,flowtype>::get_segments_packed(unsigned char* bits, node_id first, node_id last, termtype default_segm)
+{
+	int block_num = (last-first+SEGMENT_EXPORT_BLOCK-1)/SEGMENT_EXPORT_BLOCK;
+	int source_num = 0;
+	#pragma omp parallel for reduction(+:source_num) schedule(static) if(block_num > 1)
+	for (int b=0; b<block_num; b++)
+	{
+		node_id begin = first + b*SEGMENT_EXPORT_BLOCK;
+		node_id end = (last-begin > SEGMENT_EXPORT_BLOCK) ? begin+SEGMENT_EXPORT_BLOCK : last;
+		int source = 0;
+		for (node_id i=begin; i<end; i+=8)
+		{
+			int n = (end-i < 8) ? end-i : 8;
+			unsigned char byte = 0;
+			for (int k=0; k<n; k++)
+			{
+				if (nodes[i+k].parent ? !nodes[i+k].is_sink : (default_segm == SOURCE)) byte |= (1 << k);
+			}
+			bits[(i-first)>>3] = byte;
+			source += __builtin_popcount(byte);
+		}
+		source_num += source;
+	}
+	return source_num;
+}
+
 #include "instances.inc"
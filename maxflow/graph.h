@@ -41,6 +41,7 @@
 
 #include <string.h>
 #include "block.h"
+#include "../MemArena.h"
 
 #include <assert.h>
 // NOTE: in UNIX you need to use -DNDEBUG preprocessor option to supress assert's!!!
@@ -80,7 +81,8 @@ public:
 	// Also, temporarily the amount of allocated memory would be more than twice than needed.
 	// Similarly for edges.
 	// If you wish to avoid this overhead, you can download version 2.2, where nodes and edges are stored in blocks.
-	Graph(int node_num_max, int edge_num_max, void (*err_function)(char *) = NULL);
+	// If 'arena' is given, the node and arc arrays are drawn from it and released by arena->reset().
+	Graph(int node_num_max, int edge_num_max, void (*err_function)(char *) = NULL, MemArena *arena = NULL);
 
 	// Destructor
 	~Graph();
@@ -114,6 +116,14 @@ public:
 	// to both the source and the sink, then default_segm is returned.
 	termtype what_segment(node_id i, termtype default_segm = SOURCE);
 
+	// Bulk version of what_segment() for the nodes [first,last): writes source_value or sink_value
+	// to mask[i-first] and returns the number of nodes in the SOURCE segment.
+	// Blocks of nodes are exported in parallel when built with OpenMP.
+	int get_segments(unsigned char* mask, node_id first, node_id last, termtype default_segm = SOURCE,
+		unsigned char source_value = 1, unsigned char sink_value = 0);
+	// As above, one bit per node: bit (i-first)&7 of bits[(i-first)>>3] is set for SOURCE nodes.
+	int get_segments_packed(unsigned char* bits, node_id first, node_id last, termtype default_segm = SOURCE);
+
 
 
 	//////////////////////////////////////////////
@@ -300,6 +310,8 @@ private:
 
 	DBlock<nodeptr>		*nodeptr_block;
 
+	MemArena			*arena;		// owner of nodes and arcs (or NULL if they are malloc'ed)
+
 	void	(*error_function)(char *);	// this function is called if a error occurs,
 										// with a corresponding error message
 										// (or exit(1) is called if it's NULL)
@@ -18,10 +18,32 @@ template<typename T>
 int countintable(const Table2D<T> & table, T key);
 
 // save binary labeling as image
-void savebinarylabeling(const Table2D<RGB> & img, const Table2D<Label> & labeling, string savefilename, bool BW = false);
+void savebinarylabeling(const Table2DView<RGB> & img, const Table2D<Label> & labeling, const string & savefilename, bool BW = false);
 
 // error rate of segmentation
-double geterrorrate(Table2D<Label> & segmentation,Table2D<int> & groundtruth, int boxsize, int gtOBJcolor=0);
+double geterrorrate(const Table2D<Label> & segmentation, const Table2D<int> & groundtruth, int boxsize, int gtOBJcolor=0);
+
+// all accuracy measures of one segmentation, see evaluate()
+struct SegEval
+{
+	// confusion matrix, OBJ is the positive class
+	long long tp, fp, fn, tn;
+	long long unknown; // pixels whose ground truth is neither OBJ nor BKG (e.g. 128 in GrabCut trimaps)
+	int boxsize; // pixels inside the box (0 without box)
+	long long boxerrors; // errors inside the box
+	// confusion matrix restricted to the band of pixels within "bandwidth" of a ground truth boundary
+	long long bandtp, bandfp, bandfn, bandtn;
+
+	double errorrate; // (fp+fn)/boxsize as in geterrorrate()
+	double iou, precision, recall, fmeasure, accuracy;
+	double bandiou, bandaccuracy;
+};
+
+// computes confusion matrix, box errors and boundary band statistics in one pass over columns
+// (parallel over columns with OpenMP). Ground truth gtOBJcolor is BKG and 255-gtOBJcolor is OBJ, as in
+// geterrorrate(), the one pixel wide image border is not evaluated. box (255 outside) may be empty.
+SegEval evaluate(const Table2D<Label> & segmentation, const Table2D<int> & groundtruth,
+	const Table2DView<int> & box = Table2DView<int>(), int bandwidth = 2, int gtOBJcolor = 0);
 
 // get segmentation from maxflow instances (BK)
 bool getgraphlabeling(GraphType * g, Table2D<Label> & segmentation);
@@ -52,7 +74,7 @@ int countintable(const Table2D<T> & table, T key)
 	return tsize;
 }
 
-void savebinarylabeling(const Table2D<RGB> & img, const Table2D<Label> & labeling, string savefilename, bool BW)
+inline void savebinarylabeling(const Table2DView<RGB> & img, const Table2D<Label> & labeling, const string & savefilename, bool BW)
 {
 	int img_w = labeling.getWidth();
 	int img_h = labeling.getHeight();
@@ -74,30 +96,97 @@ void savebinarylabeling(const Table2D<RGB> & img, const Table2D<Label> & labelin
 	    cout<<"saved into: "<<savefilename<<endl;
 }
 
-double geterrorrate(Table2D<Label> & segmentation, Table2D<int> & groundtruth, int boxsize, int gtOBJcolor)
+inline double geterrorrate(const Table2D<Label> & segmentation, const Table2D<int> & groundtruth, int boxsize, int gtOBJcolor)
+{
+	SegEval eval = evaluate(segmentation, groundtruth, Table2DView<int>(), 0, gtOBJcolor);
+	long long errornum = eval.fp + eval.fn;
+	cout<<"errornum / boxsize "<<errornum<<' '<<boxsize<<endl;
+	return (double)errornum / boxsize;
+}
+
+inline double safedivide(long long a, long long b) {return (b==0) ? 0 : (double)a/b;}
+
+inline SegEval evaluate(const Table2D<Label> & segmentation, const Table2D<int> & groundtruth,
+	const Table2DView<int> & box, int bandwidth, int gtOBJcolor)
 {
-	double errorrate = 0 ;
-	int errornum = 0;
-	for(int j=1;j<groundtruth.getHeight()-1;j++)
+	const int img_w = groundtruth.getWidth(), img_h = groundtruth.getHeight();
+	const int gtobj = 255-gtOBJcolor, gtbkg = gtOBJcolor;
+	const int r = bandwidth;
+	const bool hasbox = !box.isEmpty();
+	long long tp=0, fp=0, fn=0, tn=0, unknown=0, boxsize=0, boxerrors=0;
+	long long bandtp=0, bandfp=0, bandfn=0, bandtn=0;
+
+	#pragma omp parallel reduction(+:tp,fp,fn,tn,unknown,boxsize,boxerrors,bandtp,bandfp,bandfn,bandtn)
 	{
-		for(int i=1;i<groundtruth.getWidth()-1;i++)
+		// per thread: rows of the current column that have OBJ / BKG ground truth within r columns
+		vector<unsigned char> nearobj(r>0 ? img_h : 0), nearbkg(r>0 ? img_h : 0);
+		#pragma omp for schedule(static)
+		for(int x=1;x<img_w-1;x++)
 		{
-			if((groundtruth[i][j]==gtOBJcolor)&&(segmentation[i][j]==OBJ))
-				errornum++;
-			else if((groundtruth[i][j]==(255-gtOBJcolor))&&(segmentation[i][j]==BKG))
-				errornum++;
+			if(r>0){
+				for(int y=0;y<img_h;y++) nearobj[y] = nearbkg[y] = 0;
+				for(int xx=std::max(x-r,0);xx<=std::min(x+r,img_w-1);xx++){
+					const int * gt_col = groundtruth[xx];
+					for(int y=0;y<img_h;y++){
+						nearobj[y] |= (gt_col[y]==gtobj);
+						nearbkg[y] |= (gt_col[y]==gtbkg);
+					}
+				}
+			}
+			const int * gt_col = groundtruth[x];
+			const Label * seg_col = segmentation[x];
+			const int * box_col = hasbox ? box[x] : NULL;
+			// OBJ / BKG counts of the vertical window [y-r,y+r] of nearobj / nearbkg, slid along the column
+			int winobj = 0, winbkg = 0;
+			for(int y=0;r>0 && y<=r && y<img_h;y++){ winobj += nearobj[y]; winbkg += nearbkg[y]; } // rows [0,r]
+			for(int y=1;y<img_h-1;y++)
+			{
+				if(r>0 && y+r<img_h){ winobj += nearobj[y+r]; winbkg += nearbkg[y+r]; }
+				int gt = gt_col[y];
+				int isobj = (seg_col[y]==OBJ);
+				int gtisobj = (gt==gtobj), gtisbkg = (gt==gtbkg);
+				tp += isobj & gtisobj;
+				fp += isobj & gtisbkg;
+				fn += (!isobj) & gtisobj;
+				tn += (!isobj) & gtisbkg;
+				unknown += !(gtisobj|gtisbkg);
+				if(hasbox){
+					int inbox = (box_col[y]!=255);
+					boxsize += inbox;
+					boxerrors += inbox & ((isobj & gtisbkg) | ((!isobj) & gtisobj));
+				}
+				if(r>0){
+					int inband = (winobj>0) & (winbkg>0);
+					bandtp += inband & isobj & gtisobj;
+					bandfp += inband & isobj & gtisbkg;
+					bandfn += inband & (!isobj) & gtisobj;
+					bandtn += inband & (!isobj) & gtisbkg;
+					if(y-r>=0){ winobj -= nearobj[y-r]; winbkg -= nearbkg[y-r]; }
+				}
+			}
 		}
 	}
-	cout<<"errornum / boxsize "<<errornum<<' '<<boxsize<<endl;
-	errorrate = (double)errornum / boxsize;
-	return errorrate;
+
+	SegEval e;
+	e.tp = tp; e.fp = fp; e.fn = fn; e.tn = tn; e.unknown = unknown;
+	e.boxsize = (int)boxsize; e.boxerrors = boxerrors;
+	e.bandtp = bandtp; e.bandfp = bandfp; e.bandfn = bandfn; e.bandtn = bandtn;
+	e.errorrate = safedivide(fp+fn, boxsize);
+	e.iou = safedivide(tp, tp+fp+fn);
+	e.precision = safedivide(tp, tp+fp);
+	e.recall = safedivide(tp, tp+fn);
+	e.fmeasure = (e.precision+e.recall>0) ? 2*e.precision*e.recall/(e.precision+e.recall) : 0;
+	e.accuracy = safedivide(tp+tn, tp+fp+fn+tn);
+	e.bandiou = safedivide(bandtp, bandtp+bandfp+bandfn);
+	e.bandaccuracy = safedivide(bandtp+bandtn, bandtp+bandfp+bandfn+bandtn);
+	return e;
 }
 
-bool getgraphlabeling(GraphType * graph, Table2D<Label> & segmentation)
+inline bool getgraphlabeling(GraphType * graph, Table2D<Label> & segmentation)
 {
 	int img_w = segmentation.getWidth();
 	int img_h = segmentation.getHeight();
-	segmentation.reset(NONE);
+	int numobj = 0; // counted in the same pass
 	for (int y=0; y<img_h; y++) 
 	{
 		for (int x=0; x<img_w; x++) 
@@ -106,24 +195,25 @@ bool getgraphlabeling(GraphType * graph, Table2D<Label> & segmentation)
 			if(graph->what_segment(n) == GraphType::SOURCE)
 			{
 				segmentation[x][y]=OBJ;
+				numobj++;
 			}
-			else if(graph->what_segment(n) == GraphType::SINK)
+			else
 			{
 				segmentation[x][y]=BKG;
 			}
 		}
 	}
-	if((countintable(segmentation, OBJ)==0)||(countintable(segmentation, BKG)==0))
+	if((numobj==0)||(numobj==img_w*img_h))
 		return false;
 	else
 		return true;
 }
 
-bool getgraphlabelingIBFS(IBFSGraph * ibfsgraph, Table2D<Label> & segmentation)
+inline bool getgraphlabelingIBFS(IBFSGraph * ibfsgraph, Table2D<Label> & segmentation)
 {
 	int img_w = segmentation.getWidth();
 	int img_h = segmentation.getHeight();
-	segmentation.reset(NONE);
+	int numobj = 0; // counted in the same pass
 	for (int y=0; y<img_h; y++) 
 	{
 		for (int x=0; x<img_w; x++) 
@@ -132,6 +222,7 @@ bool getgraphlabelingIBFS(IBFSGraph * ibfsgraph, Table2D<Label> & segmentation)
 			if(ibfsgraph->isNodeOnSrcSide(n, 999))
 			{
 				segmentation[x][y]=OBJ;
+				numobj++;
 			}
 			else
 			{
@@ -139,7 +230,7 @@ bool getgraphlabelingIBFS(IBFSGraph * ibfsgraph, Table2D<Label> & segmentation)
 			}
 		}
 	}
-	if((countintable(segmentation, OBJ)==0)||(countintable(segmentation, BKG)==0))
+	if((numobj==0)||(numobj==img_w*img_h))
 		return false;
 	else
 		return true;
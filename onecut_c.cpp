@@ -0,0 +1,187 @@
+/***********************************************************************************/
+/*          OneCut - software for interactive image segmentation                   */
+/*          "Grabcut in One Cut"                                                   */
+/*          Meng Tang, Lena Gorelick, Olga Veksler, Yuri Boykov,                   */
+/*          In IEEE International Conference on Computer Vision (ICCV), 2013       */
+/*          https://github.com/meng-tang/OneCut                                    */
+/*          Contact Author: Meng Tang (mtang73@uwo.ca)                             */
+/***********************************************************************************/
+
+#include "OneCut.h"
+#include "myutil.h"
+#include "onecut_c.h"
+#include <new>
+#include <string.h>
+
+// everything one segmentation needs, tables are kept to reuse their containers on the next call
+struct onecut_t
+{
+	onecut_t():hasimage(false),hasbox(false),solved(false),flow(-1){}
+	OneCut onecut;
+	MemArena arena; // graph memory, reset by every solve
+	Table2D<RGB> image; // column-major copy of the last image
+	Table2D<int> box;
+	Table2D<Label> seeds;
+	vector<unsigned char> mask; // last solution in node order (row-major), 255 = object
+	bool hasimage, hasbox, solved;
+	double flow;
+	mutable string error;
+
+	int fail(int code, const char * msg) const {error = msg; return code;}
+};
+
+extern "C" {
+
+onecut_t * onecut_create(void)
+{
+	return new (std::nothrow) onecut_t;
+}
+
+void onecut_destroy(onecut_t * oc)
+{
+	if(oc==NULL) return;
+	oc->onecut.setarena(NULL); // graphs go before the arena they live in
+	delete oc;
+}
+
+int onecut_set_image(onecut_t * oc, const unsigned char * rgb, int width, int height, int stride,
+	int binsize, int connectivity, int maxflow)
+{
+	if(oc==NULL) return ONECUT_ERROR_ARGUMENT;
+	if(rgb==NULL || width<=0 || height<=0 || stride<3*width)
+		return oc->fail(ONECUT_ERROR_ARGUMENT,"invalid image");
+	if(binsize<1 || binsize>256)
+		return oc->fail(ONECUT_ERROR_ARGUMENT,"binsize must be in 1..256");
+	if(connectivity!=4 && connectivity!=8 && connectivity!=16)
+		return oc->fail(ONECUT_ERROR_ARGUMENT,"connectivity must be 4, 8 or 16");
+	if(maxflow!=ONECUT_BK && maxflow!=ONECUT_IBFS && maxflow!=ONECUT_PUSHRELABEL && maxflow!=ONECUT_GRID)
+		return oc->fail(ONECUT_ERROR_ARGUMENT,"unknown maxflow algorithm");
+	try{
+		oc->onecut.setarena(NULL);
+		oc->image.resize(width,height);
+		for(int y=0;y<height;y++){
+			const unsigned char * p = rgb+(size_t)y*stride;
+			for(int x=0;x<width;x++,p+=3)
+				oc->image[x][y] = RGB(p[0],p[1],p[2]);
+		}
+		oc->onecut.setimage(oc->image,binsize,connectivity,(MAXFLOW)maxflow);
+	}
+	catch(const std::bad_alloc &){
+		oc->hasimage = false;
+		return oc->fail(ONECUT_ERROR_MEMORY,"out of memory");
+	}
+	// box and seeds belong to the previous image
+	oc->hasimage = true;
+	oc->hasbox = false;
+	oc->solved = false;
+	oc->flow = -1;
+	oc->seeds.resize(0,0);
+	oc->onecut.setseeds(Table2D<Label>());
+	return ONECUT_OK;
+}
+
+int onecut_set_box(onecut_t * oc, int x1, int y1, int x2, int y2)
+{
+	if(oc==NULL) return ONECUT_ERROR_ARGUMENT;
+	if(!oc->hasimage) return oc->fail(ONECUT_ERROR_STATE,"no image");
+	const int w = oc->image.getWidth(), h = oc->image.getHeight();
+	if(x1>x2 || y1>y2 || x2<0 || y2<0 || x1>=w || y1>=h)
+		return oc->fail(ONECUT_ERROR_ARGUMENT,"box does not intersect the image");
+	x1 = std::max(x1,0); y1 = std::max(y1,0);
+	x2 = std::min(x2,w-1); y2 = std::min(y2,h-1);
+	oc->box.resize(w,h);
+	oc->box.reset(255);
+	for(int x=x1;x<=x2;x++)
+		for(int y=y1;y<=y2;y++)
+			oc->box[x][y] = 0;
+	oc->onecut.setbox(static_cast<const Table2DView<int>&>(oc->box));
+	oc->hasbox = true;
+	return ONECUT_OK;
+}
+
+int onecut_set_box_mask(onecut_t * oc, const unsigned char * mask, int stride)
+{
+	if(oc==NULL) return ONECUT_ERROR_ARGUMENT;
+	if(!oc->hasimage) return oc->fail(ONECUT_ERROR_STATE,"no image");
+	const int w = oc->image.getWidth(), h = oc->image.getHeight();
+	if(mask==NULL || stride<w) return oc->fail(ONECUT_ERROR_ARGUMENT,"invalid box mask");
+	oc->box.resize(w,h);
+	for(int y=0;y<h;y++)
+		for(int x=0;x<w;x++)
+			oc->box[x][y] = mask[(size_t)y*stride+x] ? 0 : 255;
+	if(oc->onecut.setbox(static_cast<const Table2DView<int>&>(oc->box)).boxsize==0)
+		return oc->fail(ONECUT_ERROR_ARGUMENT,"empty box");
+	oc->hasbox = true;
+	return ONECUT_OK;
+}
+
+int onecut_set_seeds(onecut_t * oc, const unsigned char * seeds, int stride)
+{
+	if(oc==NULL) return ONECUT_ERROR_ARGUMENT;
+	if(!oc->hasimage) return oc->fail(ONECUT_ERROR_STATE,"no image");
+	if(seeds==NULL){
+		oc->onecut.setseeds(Table2D<Label>());
+		return ONECUT_OK;
+	}
+	const int w = oc->image.getWidth(), h = oc->image.getHeight();
+	if(stride<w) return oc->fail(ONECUT_ERROR_ARGUMENT,"invalid seed mask");
+	oc->seeds.resize(w,h);
+	for(int y=0;y<h;y++)
+		for(int x=0;x<w;x++){
+			unsigned char s = seeds[(size_t)y*stride+x];
+			oc->seeds[x][y] = (s==1) ? OBJ : ((s==2) ? BKG : NONE);
+		}
+	oc->onecut.setseeds(oc->seeds);
+	return ONECUT_OK;
+}
+
+int onecut_solve(onecut_t * oc, double lambda)
+{
+	if(oc==NULL) return ONECUT_ERROR_ARGUMENT;
+	if(!oc->hasimage || !oc->hasbox) return oc->fail(ONECUT_ERROR_STATE,"image and box must be set before solve");
+	if(!(lambda>=0)) return oc->fail(ONECUT_ERROR_ARGUMENT,"lambda must be non-negative");
+	try{
+		oc->arena.reset();
+		oc->onecut.setarena(&oc->arena);
+		oc->onecut.constructbkgraph((float)lambda);
+		oc->mask.resize((size_t)oc->image.getWidth()*oc->image.getHeight());
+		oc->onecut.run(&oc->mask[0],255,0);
+		oc->onecut.setarena(NULL);
+	}
+	catch(const std::bad_alloc &){
+		oc->onecut.setarena(NULL);
+		oc->solved = false;
+		return oc->fail(ONECUT_ERROR_MEMORY,"out of memory");
+	}
+	catch(const std::length_error & e){
+		oc->onecut.setarena(NULL);
+		oc->solved = false;
+		return oc->fail(ONECUT_ERROR_ARGUMENT,e.what());
+	}
+	oc->flow = oc->onecut.getflow();
+	oc->solved = true;
+	return ONECUT_OK;
+}
+
+int onecut_get_mask(const onecut_t * oc, unsigned char * mask, int stride)
+{
+	if(oc==NULL || mask==NULL) return ONECUT_ERROR_ARGUMENT;
+	if(!oc->solved) return oc->fail(ONECUT_ERROR_STATE,"not solved");
+	const int w = oc->image.getWidth(), h = oc->image.getHeight();
+	if(stride<w) return oc->fail(ONECUT_ERROR_ARGUMENT,"invalid mask stride");
+	for(int y=0;y<h;y++)
+		memcpy(mask+(size_t)y*stride,&oc->mask[(size_t)y*w],w);
+	return ONECUT_OK;
+}
+
+double onecut_get_flow(const onecut_t * oc)
+{
+	return (oc==NULL) ? -1 : oc->flow;
+}
+
+const char * onecut_last_error(const onecut_t * oc)
+{
+	return (oc==NULL) ? "no handle" : oc->error.c_str();
+}
+
+}
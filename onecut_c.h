@@ -0,0 +1,90 @@
+/***********************************************************************************/
+/*          OneCut - software for interactive image segmentation                   */
+/*          "Grabcut in One Cut"                                                   */
+/*          Meng Tang, Lena Gorelick, Olga Veksler, Yuri Boykov,                   */
+/*          In IEEE International Conference on Computer Vision (ICCV), 2013       */
+/*          https://github.com/meng-tang/OneCut                                    */
+/*          Contact Author: Meng Tang (mtang73@uwo.ca)                             */
+/***********************************************************************************/
+
+/* C interface of libonecut.
+ *
+ * Each handle owns one independent segmentation (image, box, graphs and their memory),
+ * the library has no global state and prints nothing. Different handles can be used
+ * from different threads at the same time, one handle must not be used by two threads at once.
+ *
+ *		onecut_t * oc = onecut_create();
+ *		onecut_set_image(oc, rgb, width, height, 3*width, 8, 8, ONECUT_IBFS);
+ *		onecut_set_box(oc, x1, y1, x2, y2);
+ *		onecut_solve(oc, 9.0);
+ *		onecut_get_mask(oc, mask, width);     // 255 = object, 0 = background
+ *		onecut_destroy(oc);
+ *
+ * The solvers use OpenMP and are C++: a C program links the static library with
+ *		cc app.c libonecut.a -fopenmp -lstdc++ -lm
+ * (without -fopenmp the link fails on undefined GOMP_* symbols), the shared library with -lonecut alone.
+ *
+ * All functions returning int return ONECUT_OK or a negative error code,
+ * onecut_last_error() describes the last error of a handle.
+ */
+#ifndef ONECUT_C_H
+#define ONECUT_C_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* all objects of the library are built with hidden visibility and libonecut.so is linked with the
+ * version script onecut_c.map, so only these functions are exported */
+#if defined(__GNUC__)
+#define ONECUT_API __attribute__((visibility("default")))
+#else
+#define ONECUT_API
+#endif
+
+#define ONECUT_OK 0
+#define ONECUT_ERROR_ARGUMENT -1 /* invalid argument */
+#define ONECUT_ERROR_STATE -2 /* call out of order, e.g. solve before set_image */
+#define ONECUT_ERROR_MEMORY -3 /* out of memory */
+
+/* maxflow algorithm, same as enum MAXFLOW in MaxflowSolvers.h */
+#define ONECUT_BK 0
+#define ONECUT_IBFS 1
+#define ONECUT_PUSHRELABEL 2
+#define ONECUT_GRID 3
+
+typedef struct onecut_t onecut_t;
+
+ONECUT_API onecut_t * onecut_create(void);
+ONECUT_API void onecut_destroy(onecut_t * oc);
+
+/* rgb: row-major RGB8 pixels, "stride" bytes per row (at least 3*width).
+ * binsize: color bin size (1..256), connectivity: 4, 8 or 16, maxflow: ONECUT_BK, ONECUT_IBFS, ONECUT_PUSHRELABEL or ONECUT_GRID.
+ * Color binning and grid edges are computed here once per image, box and seeds are cleared. */
+ONECUT_API int onecut_set_image(onecut_t * oc, const unsigned char * rgb, int width, int height, int stride,
+	int binsize, int connectivity, int maxflow);
+
+/* box given as an inclusive rectangle, pixels outside are background */
+ONECUT_API int onecut_set_box(onecut_t * oc, int x1, int y1, int x2, int y2);
+/* box given as a row-major mask, non-zero inside the box */
+ONECUT_API int onecut_set_box_mask(onecut_t * oc, const unsigned char * mask, int stride);
+/* optional scribbles as a row-major mask: 1 = object, 2 = background, 0 = free
+ * (NULL removes them), they are kept for the following solves */
+ONECUT_API int onecut_set_seeds(onecut_t * oc, const unsigned char * seeds, int stride);
+
+/* builds the graph for the current box with Potts weight lambda and computes the cut, ONECUT_ERROR_ARGUMENT
+ * if the image has too many arcs for the int arc indices of the maxflow (about 119M pixels at 16-connectivity) */
+ONECUT_API int onecut_solve(onecut_t * oc, double lambda);
+
+/* writes the last solution as a row-major mask, 255 = object, 0 = background */
+ONECUT_API int onecut_get_mask(const onecut_t * oc, unsigned char * mask, int stride);
+/* value of the last cut, -1 before the first solve */
+ONECUT_API double onecut_get_flow(const onecut_t * oc);
+
+ONECUT_API const char * onecut_last_error(const onecut_t * oc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,312 @@
+#include "pushrelabel.h"
+#include <string.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define PR_GLOBAL_ALPHA 6 // global relabeling after work of (PR_GLOBAL_ALPHA*numNodes+numArcs)/PR_GLOBAL_FREQ
+#define PR_GLOBAL_FREQ 0.5
+#define PR_DISCHARGE_WORK 12 // work of a discharge besides its arc scans
+#define PR_CHUNK 64 // nodes per dynamic scheduling chunk
+#define PR_EXPORT_BLOCK 65536 // nodes per block of getNodeSides()
+
+#define PR_LOAD(x) __atomic_load_n(&(x), __ATOMIC_RELAXED)
+#define PR_ADD(x, d) __atomic_fetch_add(&(x), (d), __ATOMIC_RELAXED)
+
+PushRelabelGraph::PushRelabelGraph(MemArena *a_arena)
+	: arena(a_arena), numNodes(0), numEdges(0), maxEdges(0), numThreads(0), flow(0),
+	capSource(NULL), capSink(NULL), edgeFrom(NULL), edgeTo(NULL), edgeCap(NULL), edgeRevCap(NULL),
+	firstArc(NULL), head(NULL), rcap(NULL), sister(NULL), tcap(NULL),
+	excess(NULL), addedExcess(NULL), remaining(NULL), label(NULL), newLabel(NULL),
+	inNext(NULL), work(NULL), next(NULL)
+{
+}
+
+PushRelabelGraph::~PushRelabelGraph()
+{
+	release(capSource); release(capSink);
+	release(edgeFrom); release(edgeTo); release(edgeCap); release(edgeRevCap);
+	release(firstArc); release(head); release(rcap); release(sister); release(tcap);
+	release(excess); release(addedExcess); release(remaining);
+	release(label); release(newLabel); release(inNext);
+	release(work); release(next);
+}
+
+template <class T> T* PushRelabelGraph::allocate(size_t n)
+{
+	return (arena != NULL ? arena->alloc<T>(n) : new T[n]);
+}
+
+template <class T> void PushRelabelGraph::release(T *p)
+{
+	if (arena == NULL) delete [] p;
+}
+
+int PushRelabelGraph::threads() const
+{
+#ifdef _OPENMP
+	return (numThreads > 0 ? numThreads : omp_get_max_threads());
+#else
+	return 1;
+#endif
+}
+
+void PushRelabelGraph::initSize(int a_numNodes, int a_numEdges)
+{
+	numNodes = a_numNodes;
+	maxEdges = a_numEdges;
+	numEdges = 0;
+	capSource = allocate<long long>(numNodes);
+	capSink = allocate<long long>(numNodes);
+	memset(capSource, 0, sizeof(long long)*numNodes);
+	memset(capSink, 0, sizeof(long long)*numNodes);
+	edgeFrom = allocate<int>(maxEdges);
+	edgeTo = allocate<int>(maxEdges);
+	edgeCap = allocate<int>(maxEdges);
+	edgeRevCap = allocate<int>(maxEdges);
+	firstArc = allocate<int>(numNodes+1);
+	head = allocate<int>(2*(size_t)maxEdges);
+	rcap = allocate<int>(2*(size_t)maxEdges);
+	sister = allocate<int>(2*(size_t)maxEdges);
+	tcap = allocate<long long>(numNodes);
+	excess = allocate<long long>(numNodes);
+	addedExcess = allocate<long long>(numNodes);
+	remaining = allocate<long long>(numNodes);
+	label = allocate<int>(numNodes);
+	newLabel = allocate<int>(numNodes);
+	inNext = allocate<unsigned char>(numNodes);
+	work = allocate<int>(numNodes);
+	next = allocate<int>(numNodes);
+	for (int v=0; v<numNodes; v++) label[v] = numNodes+1;
+}
+
+void PushRelabelGraph::addNode(int nodeIndex, int capFromSource, int capToSink)
+{
+	capSource[nodeIndex] += capFromSource;
+	capSink[nodeIndex] += capToSink;
+}
+
+void PushRelabelGraph::addEdge(int nodeIndexFrom, int nodeIndexTo, int capacity, int reverseCapacity)
+{
+	if (nodeIndexFrom == nodeIndexTo || (capacity == 0 && reverseCapacity == 0)) return;
+	edgeFrom[numEdges] = nodeIndexFrom;
+	edgeTo[numEdges] = nodeIndexTo;
+	edgeCap[numEdges] = capacity;
+	edgeRevCap[numEdges] = reverseCapacity;
+	numEdges++;
+}
+
+void PushRelabelGraph::buildArcs()
+{
+	// arcs by counting sort on their tail, the two arcs of an edge are sisters
+	memset(firstArc, 0, sizeof(int)*(numNodes+1));
+	for (int e=0; e<numEdges; e++) {
+		firstArc[edgeFrom[e]+1]++;
+		firstArc[edgeTo[e]+1]++;
+	}
+	for (int v=0; v<numNodes; v++) firstArc[v+1] += firstArc[v];
+	int *fill = next; // free until the first round
+	memcpy(fill, firstArc, sizeof(int)*numNodes);
+	for (int e=0; e<numEdges; e++) {
+		int a = fill[edgeFrom[e]]++, b = fill[edgeTo[e]]++;
+		head[a] = edgeTo[e]; rcap[a] = edgeCap[e]; sister[a] = b;
+		head[b] = edgeFrom[e]; rcap[b] = edgeRevCap[e]; sister[b] = a;
+	}
+}
+
+int PushRelabelGraph::gather(int *list)
+{
+	int size = 0;
+	for (size_t t=0; t<buffers.size(); t++) {
+		if (!buffers[t].empty()) memcpy(list+size, &buffers[t][0], sizeof(int)*buffers[t].size());
+		size += (int)buffers[t].size();
+		buffers[t].clear();
+	}
+	return size;
+}
+
+void PushRelabelGraph::globalRelabel()
+{
+	stats.globalRelabels++;
+	const int n = numNodes+1; // distances are at most numNodes
+	#pragma omp parallel for schedule(static) num_threads(threads())
+	for (int v=0; v<numNodes; v++) label[v] = n;
+	// breadth-first search from the sink over reverse residual arcs, one level at a time
+	int size = 0;
+	for (int v=0; v<numNodes; v++) if (tcap[v] > 0) {label[v] = 1; work[size++] = v;}
+	for (int d=2; size > 0; d++) {
+		#pragma omp parallel num_threads(threads())
+		{
+#ifdef _OPENMP
+			std::vector<int> & buffer = buffers[omp_get_thread_num()];
+#else
+			std::vector<int> & buffer = buffers[0];
+#endif
+			#pragma omp for schedule(dynamic, PR_CHUNK)
+			for (int i=0; i<size; i++) {
+				int u = work[i];
+				for (int a=firstArc[u]; a<firstArc[u+1]; a++) {
+					int w = head[a], expected = n;
+					if (PR_LOAD(rcap[sister[a]]) > 0 && PR_LOAD(label[w]) == n &&
+						__atomic_compare_exchange_n(&label[w], &expected, d, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+						buffer.push_back(w);
+				}
+			}
+		}
+		size = gather(work);
+	}
+}
+
+long long PushRelabelGraph::computeMaxFlow()
+{
+	const int n = numNodes+1; // label of the nodes cut off from the sink, distances are at most numNodes
+	stats = PushRelabelStats();
+	buffers.assign(threads(), std::vector<int>());
+	buildArcs();
+	// saturate the t-links: both of a node carry flow straight from source to sink
+	flow = 0;
+	for (int v=0; v<numNodes; v++) {
+		long long both = (capSource[v] < capSink[v] ? capSource[v] : capSink[v]);
+		flow += both;
+		excess[v] = capSource[v]-both;
+		tcap[v] = capSink[v]-both;
+		addedExcess[v] = 0;
+		inNext[v] = 0;
+	}
+	globalRelabel();
+	int size = 0;
+	for (int v=0; v<numNodes; v++) if (excess[v] > 0 && label[v] < n) work[size++] = v;
+
+	const double globalWork = (PR_GLOBAL_ALPHA*(double)numNodes+2.0*numEdges)/PR_GLOBAL_FREQ;
+	double workSinceRelabel = 0;
+	while (size > 0) {
+		stats.rounds++;
+		long long sinkFlow = 0, pushes = 0, relabels = 0, roundWork = 0;
+		#pragma omp parallel num_threads(threads()) reduction(+:sinkFlow,pushes,relabels,roundWork)
+		{
+#ifdef _OPENMP
+			std::vector<int> & buffer = buffers[omp_get_thread_num()];
+#else
+			std::vector<int> & buffer = buffers[0];
+#endif
+			#pragma omp for schedule(dynamic, PR_CHUNK)
+			for (int i=0; i<size; i++) {
+				// discharge v against the labels and excesses of the previous round
+				const int v = work[i], dv = label[v];
+				long long e = excess[v];
+				int lv = dv;
+				roundWork += PR_DISCHARGE_WORK;
+				while (e > 0) {
+					int newLv = n;
+					bool skipped = false;
+					if (tcap[v] > 0 && lv == 1) { // the sink has the label 0
+						long long delta = (e < tcap[v] ? e : tcap[v]);
+						tcap[v] -= delta;
+						e -= delta;
+						sinkFlow += delta;
+						pushes++;
+					}
+					for (int a=firstArc[v]; a<firstArc[v+1] && e > 0; a++) {
+						roundWork++;
+						int r = PR_LOAD(rcap[a]);
+						if (r == 0) continue;
+						const int w = head[a], dw = label[w];
+						bool admissible = (lv == dw+1);
+						if (excess[w] > 0 && dw < n) {
+							// of two adjacent active nodes only the winner pushes to the other
+							bool win = (dv == dw+1) || (dv < dw-1) || (dv == dw && v < w);
+							if (admissible && !win) {skipped = true; continue;}
+						}
+						if (admissible) {
+							int delta = (e < r ? (int)e : r);
+							PR_ADD(rcap[a], -delta);
+							PR_ADD(rcap[sister[a]], delta);
+							PR_ADD(addedExcess[w], (long long)delta);
+							e -= delta;
+							r -= delta;
+							pushes++;
+							if (__atomic_exchange_n(&inNext[w], 1, __ATOMIC_RELAXED) == 0) buffer.push_back(w);
+						}
+						if (r > 0 && dw >= lv && dw+1 < newLv) newLv = dw+1;
+					}
+					if (e == 0 || skipped) break;
+					lv = newLv; // relabel
+					relabels++;
+					if (lv >= n) break;
+				}
+				newLabel[v] = lv;
+				remaining[v] = e;
+				if (e > 0 && __atomic_exchange_n(&inNext[v], 1, __ATOMIC_RELAXED) == 0) buffer.push_back(v);
+			}
+		}
+		flow += sinkFlow;
+		stats.pushes += pushes;
+		stats.relabels += relabels;
+		workSinceRelabel += roundWork;
+
+		// the new labels and excesses, the nodes that received excess or kept some are the next work
+		#pragma omp parallel for schedule(static) num_threads(threads())
+		for (int i=0; i<size; i++) {
+			int v = work[i];
+			label[v] = newLabel[v];
+			excess[v] = remaining[v];
+		}
+		int nextSize = gather(next);
+		#pragma omp parallel for schedule(static) num_threads(threads())
+		for (int i=0; i<nextSize; i++) {
+			int w = next[i];
+			excess[w] += addedExcess[w];
+			addedExcess[w] = 0;
+			inNext[w] = 0;
+		}
+		if (workSinceRelabel > globalWork) {
+			globalRelabel();
+			workSinceRelabel = 0;
+			size = 0;
+			for (int v=0; v<numNodes; v++) if (excess[v] > 0 && label[v] < n) work[size++] = v;
+		} else {
+			size = 0;
+			for (int i=0; i<nextSize; i++) if (excess[next[i]] > 0 && label[next[i]] < n) work[size++] = next[i];
+		}
+	}
+	// exact labels: the nodes that can still reach the sink are the sink side
+	globalRelabel();
+	return flow;
+}
+
+int PushRelabelGraph::getNodeSides(unsigned char *mask, int first, int last,
+	unsigned char srcValue, unsigned char sinkValue) const
+{
+	int numBlocks = (last-first+PR_EXPORT_BLOCK-1)/PR_EXPORT_BLOCK;
+	int numSrc = 0;
+	#pragma omp parallel for reduction(+:numSrc) schedule(static) if(numBlocks > 1)
+	for (int b=0; b<numBlocks; b++) {
+		int begin = first + b*PR_EXPORT_BLOCK;
+		int end = (last-begin > PR_EXPORT_BLOCK ? begin+PR_EXPORT_BLOCK : last);
+		for (int i=begin; i<end; i++) {
+			bool src = (label[i] > numNodes);
+			mask[i-first] = (src ? srcValue : sinkValue);
+			numSrc += src;
+		}
+	}
+	return numSrc;
+}
+
+int PushRelabelGraph::getNodeSidesPacked(unsigned char *bits, int first, int last) const
+{
+	int numBlocks = (last-first+PR_EXPORT_BLOCK-1)/PR_EXPORT_BLOCK;
+	int numSrc = 0;
+	#pragma omp parallel for reduction(+:numSrc) schedule(static) if(numBlocks > 1)
+	for (int b=0; b<numBlocks; b++) {
+		int begin = first + b*PR_EXPORT_BLOCK;
+		int end = (last-begin > PR_EXPORT_BLOCK ? begin+PR_EXPORT_BLOCK : last);
+		for (int i=begin; i<end; i+=8) {
+			int k, count = (end-i < 8 ? end-i : 8);
+			unsigned char byte = 0;
+			for (k=0; k<count; k++) if (label[i+k] > numNodes) byte |= (1 << k);
+			bits[(i-first)>>3] = byte;
+			numSrc += __builtin_popcount(byte);
+		}
+	}
+	return numSrc;
+}
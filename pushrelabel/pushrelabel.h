@@ -0,0 +1,117 @@
+/*
+	PushRelabelGraph - parallel maximum s-t flow / minimum s-t cut by synchronous push-relabel
+
+	A lock-free push-relabel algorithm after
+		"Efficient Implementation of a Synchronous Parallel Push-Relabel Algorithm"
+		Niklas Baumstark, Guy Blelloch and Julian Shun
+		In Proceedings of the 23rd European conference on Algorithms, ESA'15
+		2015
+
+	The algorithm works in rounds. All active nodes (positive excess, distance label below the number of
+	nodes) are discharged in parallel against the labels of the previous round: a node pushes to its
+	neighbors and relabels itself locally, excess it sends is added atomically to the receiving node and
+	becomes visible in the next round. Of two adjacent active nodes only one may push to the other, so the
+	residual capacities of an arc pair are only changed by one thread in a round. A global relabeling (a
+	parallel breadth-first search from the sink over residual arcs) recomputes exact labels after work
+	proportional to the graph size; it also performs the gap heuristic, nodes that can no longer reach the
+	sink get the label numNodes+1 and are never discharged again.
+
+	The algorithm stops with a maximum preflow: nodes that can reach the sink in the residual graph are on
+	the sink side of the minimum cut, all others (including nodes left with excess) on the source side,
+	which is the maximal source side of all minimum cuts.
+
+	Capacities are ints as in IBFSGraph, the flow is a long long.
+
+		PushRelabelGraph g;
+		g.initSize(numNodes, numEdges);
+		g.addNode(i, capFromSource, capToSink);
+		g.addEdge(i, j, capacity, reverseCapacity);
+		long long flow = g.computeMaxFlow();
+		bool obj = g.isNodeOnSrcSide(i);
+*/
+
+#ifndef _PUSHRELABEL_H__
+#define _PUSHRELABEL_H__
+
+#include <vector>
+#include "../MemArena.h"
+
+struct PushRelabelStats
+{
+	PushRelabelStats() : rounds(0), globalRelabels(0), pushes(0), relabels(0) {}
+	int rounds;
+	int globalRelabels;
+	long long pushes;
+	long long relabels;
+};
+
+class PushRelabelGraph
+{
+public:
+	// with an arena all arrays are drawn from it and released with it
+	PushRelabelGraph(MemArena *a_arena = NULL);
+	~PushRelabelGraph();
+
+	void initSize(int numNodes, int numEdges);
+	// capacities are added to the t-links of the node
+	void addNode(int nodeIndex, int capFromSource, int capToSink);
+	void addEdge(int nodeIndexFrom, int nodeIndexTo, int capacity, int reverseCapacity);
+
+	long long computeMaxFlow();
+	inline long long getFlow() const {
+		return flow;
+	}
+	inline int getNumNodes() const {
+		return numNodes;
+	}
+	inline int getNumArcs() const {
+		return 2*numEdges;
+	}
+	// after computeMaxFlow(): nodes that can not reach the sink in the residual graph
+	inline bool isNodeOnSrcSide(int nodeIndex) const {
+		return label[nodeIndex] > numNodes;
+	}
+	// bulk isNodeOnSrcSide() for the nodes [first,last), as IBFSGraph::getNodeSides(). Returns the number
+	// of source side nodes.
+	int getNodeSides(unsigned char *mask, int first, int last,
+		unsigned char srcValue = 1, unsigned char sinkValue = 0) const;
+	// as above, one bit per node: bit (i-first)&7 of bits[(i-first)>>3] is set for source side nodes
+	int getNodeSidesPacked(unsigned char *bits, int first, int last) const;
+
+	// number of threads of computeMaxFlow(), 0 for the OpenMP default
+	inline void setNumThreads(int n) {
+		numThreads = n;
+	}
+	inline const PushRelabelStats & getStats() const {
+		return stats;
+	}
+
+private:
+	MemArena *arena;
+	int numNodes, numEdges, maxEdges;
+	int numThreads;
+	long long flow;
+	PushRelabelStats stats;
+
+	// as added
+	long long *capSource, *capSink;
+	int *edgeFrom, *edgeTo, *edgeCap, *edgeRevCap;
+
+	// residual graph: arcs of node v are [firstArc[v], firstArc[v+1]), sister is the reverse arc
+	int *firstArc, *head, *rcap, *sister;
+	long long *tcap; // residual capacity to the sink
+	long long *excess, *addedExcess, *remaining; // remaining: excess at the end of the discharge of a round
+	int *label, *newLabel;
+	unsigned char *inNext;
+	int *work, *next;
+	std::vector<std::vector<int> > buffers; // per thread
+
+	template <class T> T* allocate(size_t n);
+	template <class T> void release(T *p);
+	void buildArcs();
+	void globalRelabel();
+	int gather(int *list); // concatenates the per thread buffers into list
+	int threads() const;
+};
+
+#endif
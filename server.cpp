@@ -0,0 +1,520 @@
+/***********************************************************************************/
+/*          OneCut - software for interactive image segmentation                   */
+/*          "Grabcut in One Cut"                                                   */
+/*          Meng Tang, Lena Gorelick, Olga Veksler, Yuri Boykov,                   */
+/*          In IEEE International Conference on Computer Vision (ICCV), 2013       */
+/*          https://github.com/meng-tang/OneCut                                    */
+/*          Contact Author: Meng Tang (mtang73@uwo.ca)                             */
+/***********************************************************************************/
+
+// Long-running segmentation server. Images, OneCut state (color binning, edges) and
+// graph memory stay warm between requests, so a request only pays for graph construction
+// and maxflow.
+//
+// usage: server [--socket path] [--workers n] [--sessions n]
+//   without --socket requests are read from stdin and responses written to stdout
+//   --sessions: named sessions kept per worker (16), a new session evicts the least recently used one
+// client.cpp (make client) sends requests to a socket from the command line, ServerClient.h from code.
+//
+// protocol: every message is one header line of space separated key=value tokens,
+// followed by "bytes" bytes of payload (no payload if bytes is missing or 0)
+//
+//   request:  cmd=segment id=7 session=a image=images/326038.bmp box=30,40,200,180 lambda=9
+//             cmd=segment id=8 session=a fg=120,100,130,100 bg=35,45 brush=3
+//             cmd=segment id=9 format=rgb width=W height=H bytes=3*W*H   (row-major RGB payload)
+//             cmd=close session=a | cmd=ping id=1 | cmd=quit
+//   response: id=7 status=ok width=W height=H obj=N bytes=W*H   (row-major mask, 255 = OBJ, 0 = BKG)
+//             id=7 status=ok width=W height=H obj=N output=bits bytes=(W*H+7)/8   (see BitMask)
+//             id=7 status=ok width=W height=H obj=N output=rle runs=R bytes=4*R   (uint32 runs, see RLEMask)
+//             id=7 status=error msg=...
+//
+// segment keys: image=path (BMP) or format=rgb payload; box=x1,y1,x2,y2 (inclusive) or
+// boxfile=path (BMP, 255 outside); fg=/bg= scribbles as x,y,x,y,... painted with a brush of
+// radius brush; lambda (Potts weight, 9), binsize (8), connectivity (8), maxflow=ibfs|bk|pr|grid,
+// output=bytes|bits|rle (format of the returned mask, bytes by default).
+// A session keeps its image, box and parameters, a request only sends what changed.
+// Requests of one session are handled in order by the same worker. An evicted session answers
+// "no image in session" until its image is sent again.
+// A payload is at most 3*MAXPIXELS bytes; a request with a larger or malformed "bytes" is answered
+// with an error and the connection is closed, as the rest of the stream can not be parsed.
+
+#include "OneCut.h"
+#include "myutil.h"
+#include <iostream>
+#include <sstream>
+#include <map>
+#include <deque>
+#include <list>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <atomic>
+#include <functional>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+typedef map<string,string> Header;
+
+static const size_t MAXPIXELS = (size_t)1<<28; // largest image sent as format=rgb
+
+// one client connection, responses of different workers are serialized by a mutex
+struct Connection
+{
+	Connection(int in_, int out_, bool owned_ = false):in(in_),out(out_),owned(owned_),begin(0),end(0){}
+	~Connection() {if(owned) close(in);} // closed once the last pending response is written
+	int in, out;
+	bool owned; // the socket belongs to the connection
+	std::mutex writelock;
+	char buffer[1<<16];
+	size_t begin, end;
+
+	bool fill()
+	{
+		if(begin==end) begin = end = 0;
+		ssize_t n;
+		do n = read(in,buffer+end,sizeof(buffer)-end); while(n<0 && errno==EINTR);
+		if(n<=0) return false;
+		end += n;
+		return true;
+	}
+	bool readline(string & line)
+	{
+		line.clear();
+		while(true){
+			char * nl = (char*)memchr(buffer+begin,'\n',end-begin);
+			if(nl){
+				line.append(buffer+begin,nl);
+				begin = nl-buffer+1;
+				return true;
+			}
+			line.append(buffer+begin,buffer+end);
+			begin = end;
+			if(!fill()) return !line.empty();
+		}
+	}
+	bool readbytes(char * data, size_t size)
+	{
+		while(size>0){
+			if(begin==end && !fill()) return false;
+			size_t n = std::min(size,end-begin);
+			memcpy(data,buffer+begin,n);
+			begin += n; data += n; size -= n;
+		}
+		return true;
+	}
+	void writeall(const char * data, size_t size)
+	{
+		while(size>0){
+			ssize_t n = write(out,data,size);
+			if(n<0){ if(errno==EINTR) continue; return; }
+			data += n; size -= n;
+		}
+	}
+	void respond(const string & header, const vector<unsigned char> & payload = vector<unsigned char>())
+	{
+		std::lock_guard<std::mutex> guard(writelock);
+		writeall(header.data(),header.size());
+		if(!payload.empty()) writeall((const char*)&payload[0],payload.size());
+	}
+};
+
+struct Request
+{
+	Header header;
+	vector<char> payload;
+	std::shared_ptr<Connection> connection;
+};
+
+// per-session state kept by the worker the session is assigned to
+struct Session
+{
+	Session():binsize(8),connectivity(8),lambda(9.0),maxflowoption(IBFS),ready(false),lastuse(0){}
+	Table2D<RGB> image;
+	Table2D<int> box;
+	OneCut onecut;
+	int binsize, connectivity;
+	double lambda;
+	MAXFLOW maxflowoption;
+	bool ready; // onecut is set up for image with the current parameters
+	unsigned long long lastuse; // request count of the worker at the last request of the session
+};
+
+static string get(const Header & h, const string & key, const string & def = "")
+{
+	Header::const_iterator it = h.find(key);
+	return it==h.end() ? def : it->second;
+}
+
+static Header parseheader(const string & line)
+{
+	Header h;
+	istringstream in(line);
+	string token;
+	while(in>>token){
+		size_t eq = token.find('=');
+		if(eq==string::npos) h[token] = "";
+		else h[token.substr(0,eq)] = token.substr(eq+1);
+	}
+	return h;
+}
+
+static vector<int> parseints(const string & s)
+{
+	vector<int> v;
+	istringstream in(s);
+	string token;
+	while(getline(in,token,',')) v.push_back(atoi(token.c_str()));
+	return v;
+}
+
+// paints the scribble points with a round brush into the seed table
+static void paintseeds(Table2D<Label> & seeds, const string & points, int brush, Label label)
+{
+	vector<int> v = parseints(points);
+	if(v.size()%2) throw string("odd number of scribble coordinates");
+	for(size_t i=0;i<v.size();i+=2)
+		for(int x=v[i]-brush;x<=v[i]+brush;x++)
+			for(int y=v[i+1]-brush;y<=v[i+1]+brush;y++)
+				if(seeds.pointIn(x,y) && (x-v[i])*(x-v[i])+(y-v[i+1])*(y-v[i+1])<=brush*brush)
+					seeds[x][y] = label;
+}
+
+class Worker
+{
+public:
+	Worker(size_t maxsessions_):maxsessions(maxsessions_),uses(0),quit(false),thread(&Worker::loop,this){}
+	~Worker()
+	{
+		{ std::lock_guard<std::mutex> guard(lock); quit = true; }
+		wakeup.notify_one();
+		thread.join();
+	}
+	void push(Request * r)
+	{
+		{ std::lock_guard<std::mutex> guard(lock); queue.push_back(r); }
+		wakeup.notify_one();
+	}
+private:
+	MemArena arena; // graph memory of the current request, kept for the next one
+	RLEMask rle; // reused by output=rle
+	map<string,Session> sessions;
+	size_t maxsessions;
+	unsigned long long uses;
+	std::deque<Request*> queue;
+	std::mutex lock;
+	std::condition_variable wakeup;
+	bool quit;
+	std::thread thread;
+
+	void loop()
+	{
+		while(true){
+			Request * r;
+			{
+				std::unique_lock<std::mutex> guard(lock);
+				while(queue.empty() && !quit) wakeup.wait(guard);
+				if(queue.empty()) return;
+				r = queue.front();
+				queue.pop_front();
+			}
+			handle(*r);
+			delete r;
+		}
+	}
+	// the session of a request, a new session evicts the least recently used one when the worker is full
+	Session & opensession(const string & name)
+	{
+		map<string,Session>::iterator it = sessions.find(name);
+		if(it==sessions.end() && sessions.size()>=maxsessions){
+			map<string,Session>::iterator lru = sessions.begin();
+			for(it=sessions.begin();it!=sessions.end();++it)
+				if(it->second.lastuse<lru->second.lastuse) lru = it;
+			sessions.erase(lru);
+		}
+		Session & s = sessions[name];
+		s.lastuse = ++uses;
+		return s;
+	}
+	void handle(Request & r)
+	{
+		const string cmd = get(r.header,"cmd");
+		const string id = get(r.header,"id");
+		const string output = get(r.header,"output","bytes");
+		if(output!="bytes" && output!="bits" && output!="rle"){
+			r.connection->respond("id="+id+" status=error msg=unknown_output\n");
+			return;
+		}
+		if(cmd=="close"){
+			sessions.erase(get(r.header,"session"));
+			r.connection->respond("id="+id+" status=ok\n");
+			return;
+		}
+		vector<unsigned char> mask;
+		int obj = 0;
+		Session * session = NULL;
+		try{
+			session = &opensession(get(r.header,"session"));
+			obj = segment(r,*session,mask);
+		}
+		catch(const string & msg){
+			// an anonymous session must not keep a half configured state
+			if(get(r.header,"session").empty()) sessions.erase("");
+			else if(session) session->ready = false;
+			string text = msg;
+			std::replace(text.begin(),text.end(),' ','_');
+			r.connection->respond("id="+id+" status=error msg="+text+"\n");
+			return;
+		}
+		ostringstream out;
+		out<<"id="<<id<<" status=ok width="<<session->image.getWidth()<<" height="<<session->image.getHeight()
+			<<" obj="<<obj;
+		if(output=="bits") out<<" output=bits";
+		else if(output=="rle") out<<" output=rle runs="<<mask.size()/4;
+		out<<" bytes="<<mask.size()<<"\n";
+		r.connection->respond(out.str(),mask);
+		if(get(r.header,"session").empty()) sessions.erase("");
+	}
+	int segment(Request & r, Session & s, vector<unsigned char> & mask)
+	{
+		const Header & h = r.header;
+		// image, only loaded when sent
+		string image = get(h,"image");
+		if(!image.empty()){
+			if(access(image.c_str(),R_OK)!=0) throw "can not read "+image;
+			s.image = loadImage<RGB>(image.c_str());
+			s.ready = false;
+		}
+		else if(get(h,"format")=="rgb"){
+			int w = atoi(get(h,"width").c_str()), hgt = atoi(get(h,"height").c_str());
+			if(w<=0 || hgt<=0 || (size_t)w*hgt>MAXPIXELS || r.payload.size()!=(size_t)w*hgt*3)
+				throw string("payload does not match width*height*3");
+			s.image.resize(w,hgt);
+			const unsigned char * p = (const unsigned char*)&r.payload[0];
+			for(int y=0;y<hgt;y++)
+				for(int x=0;x<w;x++,p+=3)
+					s.image[x][y] = RGB(p[0],p[1],p[2]);
+			s.ready = false;
+		}
+		if(s.image.isEmpty()) throw string("no image in session");
+		const int w = s.image.getWidth(), hgt = s.image.getHeight();
+
+		// parameters
+		if(!get(h,"binsize").empty() && atoi(get(h,"binsize").c_str())!=s.binsize){
+			s.binsize = atoi(get(h,"binsize").c_str()); s.ready = false;
+		}
+		if(!get(h,"connectivity").empty() && atoi(get(h,"connectivity").c_str())!=s.connectivity){
+			s.connectivity = atoi(get(h,"connectivity").c_str()); s.ready = false;
+		}
+		if(!get(h,"maxflow").empty()){
+			string name = get(h,"maxflow");
+			if(name!="ibfs" && name!="bk" && name!="pr" && name!="grid") throw string("unknown maxflow");
+			MAXFLOW m = (name=="bk") ? BK : ((name=="pr") ? PUSHRELABEL : ((name=="grid") ? GRID : IBFS));
+			if(m!=s.maxflowoption){ s.maxflowoption = m; s.ready = false; }
+		}
+		if(!get(h,"lambda").empty()) s.lambda = atof(get(h,"lambda").c_str());
+		if(s.binsize<1 || s.binsize>256) throw string("binsize must be in 1..256");
+		if(s.connectivity!=4 && s.connectivity!=8 && s.connectivity!=16) throw string("connectivity must be 4, 8 or 16");
+
+		// box
+		string boxfile = get(h,"boxfile"), rect = get(h,"box");
+		if(!boxfile.empty()){
+			if(access(boxfile.c_str(),R_OK)!=0) throw "can not read "+boxfile;
+			s.box = loadImage<RGB>(boxfile.c_str());
+		}
+		else if(!rect.empty()){
+			vector<int> v = parseints(rect);
+			if(v.size()!=4) throw string("box needs x1,y1,x2,y2");
+			s.box.resize(w,hgt);
+			s.box.reset(255);
+			for(int x=std::max(v[0],0);x<=std::min(v[2],w-1);x++)
+				for(int y=std::max(v[1],0);y<=std::min(v[3],hgt-1);y++)
+					s.box[x][y] = 0;
+		}
+		if(s.box.isEmpty()) throw string("no box in session");
+		if(s.box.getWidth()!=w || s.box.getHeight()!=hgt) throw string("box does not match the image size");
+
+		if(!s.ready){
+			s.onecut.setimage(s.image,s.binsize,s.connectivity,s.maxflowoption);
+			s.ready = true;
+		}
+
+		// scribbles only apply to the request that carries them
+		string fg = get(h,"fg"), bg = get(h,"bg");
+		Table2D<Label> seeds;
+		if(!fg.empty() || !bg.empty()){
+			int brush = atoi(get(h,"brush","3").c_str());
+			seeds.resize(w,hgt);
+			seeds.reset(NONE);
+			paintseeds(seeds,fg,brush,OBJ);
+			paintseeds(seeds,bg,brush,BKG);
+		}
+		s.onecut.setseeds(std::move(seeds));
+
+		int obj;
+		try{
+			arena.reset();
+			s.onecut.setarena(&arena);
+			s.onecut.setbox(static_cast<const Table2DView<int>&>(s.box));
+			s.onecut.constructbkgraph((float)s.lambda);
+			// node order is the row-major order of the response
+			string output = get(h,"output","bytes");
+			if(output=="bits"){
+				mask.resize(((size_t)w*hgt+7)/8);
+				obj = s.onecut.runpacked(&mask[0]);
+			}
+			else if(output=="rle"){
+				obj = s.onecut.run(rle);
+				const vector<unsigned> & runs = rle.getRuns();
+				mask.resize(4*runs.size());
+				for(size_t i=0;i<runs.size();i++) // little endian
+					for(int k=0;k<4;k++) mask[4*i+k] = (unsigned char)(runs[i]>>(8*k));
+			}
+			else{
+				mask.resize((size_t)w*hgt);
+				obj = s.onecut.run(&mask[0],255,0);
+			}
+		}
+		catch(const std::bad_alloc &){
+			s.onecut.setarena(NULL);
+			throw string("out of memory");
+		}
+		catch(const std::length_error & e){
+			s.onecut.setarena(NULL);
+			throw string(e.what());
+		}
+		s.onecut.setarena(NULL); // releases the graphs while the arena memory is still valid
+		return obj;
+	}
+};
+
+// a client of the socket: its connection, open while the reader or a pending response holds it, and the
+// thread reading its requests
+struct Client
+{
+	Client(std::shared_ptr<Connection> connection_):connection(connection_),done(false){}
+	std::weak_ptr<Connection> connection;
+	std::thread reader;
+	std::atomic<bool> done; // the reader returned and can be joined
+};
+
+// reads requests from one connection and hands them to the workers,
+// returns false when the client asked the server to quit
+static bool serve(std::shared_ptr<Connection> connection, vector<Worker*> & workers, std::atomic<int> & anonymous)
+{
+	string line;
+	while(connection->readline(line)){
+		Header h = parseheader(line);
+		if(h.empty()) continue;
+		string cmd = get(h,"cmd","segment");
+		Request * r = new Request;
+		r->header = h;
+		r->connection = connection;
+		string length = get(h,"bytes","0");
+		char * end;
+		unsigned long long bytes = strtoull(length.c_str(),&end,10);
+		if(length.empty() || *end!='\0' || length[0]=='-' || bytes>3*MAXPIXELS){
+			connection->respond("id="+get(h,"id")+" status=error msg=invalid_bytes\n");
+			delete r;
+			return true;
+		}
+		r->payload.resize(bytes);
+		if(bytes>0 && !connection->readbytes(&r->payload[0],bytes)){ delete r; return true; }
+		if(cmd=="quit"){ delete r; return false; }
+		if(cmd=="ping"){
+			connection->respond("id="+get(h,"id")+" status=ok\n");
+			delete r;
+			continue;
+		}
+		if(cmd!="segment" && cmd!="close"){
+			connection->respond("id="+get(h,"id")+" status=error msg=unknown_command\n");
+			delete r;
+			continue;
+		}
+		// a session always goes to the same worker, anonymous requests are spread round robin
+		string session = get(h,"session");
+		size_t k = session.empty() ? (size_t)(anonymous++) : std::hash<string>()(session);
+		workers[k%workers.size()]->push(r);
+	}
+	return true;
+}
+
+int main(int argc, char * argv[])
+{
+	string socketpath;
+	int numworkers = (int)std::thread::hardware_concurrency();
+	int maxsessions = 16;
+	for(int i=1;i<argc;i++){
+		if(!strcmp(argv[i],"--socket") && i+1<argc) socketpath = argv[++i];
+		else if(!strcmp(argv[i],"--workers") && i+1<argc) numworkers = atoi(argv[++i]);
+		else if(!strcmp(argv[i],"--sessions") && i+1<argc) maxsessions = atoi(argv[++i]);
+		else{ cerr<<"usage: "<<argv[0]<<" [--socket path] [--workers n] [--sessions n]"<<endl; return 1; }
+	}
+	if(numworkers<1) numworkers = 1;
+	if(maxsessions<1) maxsessions = 1;
+	signal(SIGPIPE,SIG_IGN);
+
+	// responses go to the original stdout, everything the library prints goes to stderr
+	int out = dup(1);
+	dup2(2,1);
+	cout.rdbuf(cerr.rdbuf());
+
+	vector<Worker*> workers;
+	for(int i=0;i<numworkers;i++) workers.push_back(new Worker(maxsessions));
+	std::atomic<int> anonymous(0);
+
+	if(socketpath.empty())
+		serve(std::make_shared<Connection>(0,out),workers,anonymous);
+	else{
+		int listener = socket(AF_UNIX,SOCK_STREAM,0);
+		sockaddr_un addr;
+		memset(&addr,0,sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		strncpy(addr.sun_path,socketpath.c_str(),sizeof(addr.sun_path)-1);
+		unlink(socketpath.c_str());
+		if(listener<0 || bind(listener,(sockaddr*)&addr,sizeof(addr))<0 || listen(listener,16)<0){
+			cerr<<"can not listen on "<<socketpath<<": "<<strerror(errno)<<endl;
+			return 1;
+		}
+		// one reader thread per client, the workers are shared. Readers are joined before the workers
+		// are deleted.
+		std::atomic<bool> running(true);
+		std::list<std::unique_ptr<Client> > clients;
+		while(running){
+			int fd = accept(listener,NULL,NULL);
+			if(fd<0){ if(errno==EINTR) continue; break; }
+			for(std::list<std::unique_ptr<Client> >::iterator it=clients.begin();it!=clients.end();){
+				if((*it)->done){ (*it)->reader.join(); it = clients.erase(it); }
+				else ++it;
+			}
+			std::shared_ptr<Connection> connection = std::make_shared<Connection>(fd,fd,true);
+			clients.push_back(std::unique_ptr<Client>(new Client(connection)));
+			Client * client = clients.back().get();
+			client->reader = std::thread([&,client,connection](){
+				bool keep = serve(connection,workers,anonymous);
+				if(!keep){
+					// unblock accept so the main loop sees the quit
+					running = false;
+					shutdown(listener,SHUT_RDWR);
+				}
+				client->done = true;
+			});
+		}
+		// readers still waiting for a request see the end of their stream, responses can still be written
+		for(std::list<std::unique_ptr<Client> >::iterator it=clients.begin();it!=clients.end();++it){
+			std::shared_ptr<Connection> connection = (*it)->connection.lock();
+			if(connection) shutdown(connection->in,SHUT_RD);
+		}
+		for(std::list<std::unique_ptr<Client> >::iterator it=clients.begin();it!=clients.end();++it)
+			(*it)->reader.join();
+		clients.clear();
+		close(listener);
+		unlink(socketpath.c_str());
+	}
+	for(size_t i=0;i<workers.size();i++) delete workers[i]; // finishes the queued requests
+	return 0;
+}
@@ -0,0 +1,100 @@
+/***********************************************************************************/
+/*          OneCut - software for interactive image segmentation                   */
+/*          "Grabcut in One Cut"                                                   */
+/*          Meng Tang, Lena Gorelick, Olga Veksler, Yuri Boykov,                   */
+/*          In IEEE International Conference on Computer Vision (ICCV), 2013       */
+/*          https://github.com/meng-tang/OneCut                                    */
+/*          Contact Author: Meng Tang (mtang73@uwo.ca)                             */
+/***********************************************************************************/
+
+// Out-of-core segmentation of an image larger than RAM with TiledCut: the image is a binary PPM (P6),
+// the box a rectangle, the result a PGM (P5) mask written through a memory mapping.
+//
+// usage: tiledcut image.ppm x1 y1 x2 y2 mask.pgm [--tile n | --budget MB] [--binsize n]
+//                 [--connectivity n] [--lambda w] [--sweeps n] [--arena file]
+//
+// --budget picks the largest tile whose graph fits in MB megabytes, --arena pages the graphs to a file.
+// The mask is approximate, the energy is printed with a lower bound on the one of the exact OneCut mask.
+
+#include "TiledCut.h"
+#include <iostream>
+#include <chrono>
+#include <string.h>
+
+// peak resident set size in kB
+static long peakrss()
+{
+	FILE * f = fopen("/proc/self/status","r");
+	if(f==NULL) return -1;
+	char line[256];
+	long kb = -1;
+	while(fgets(line,sizeof(line),f))
+		if(strncmp(line,"VmHWM:",6)==0) kb = atol(line+6);
+	fclose(f);
+	return kb;
+}
+
+int main(int argc, char * argv[])
+{
+	int tilesize = 1024, binsize = 8, connectivity = 8, sweeps = 8;
+	double lambda = 9.0;
+	string arenafile;
+	vector<string> positional;
+	for(int i=1;i<argc;i++){
+		string arg = argv[i];
+		bool hasvalue = (i+1<argc);
+		if(arg=="--tile" && hasvalue) tilesize = atoi(argv[++i]);
+		else if(arg=="--budget" && hasvalue) tilesize = -atoi(argv[++i]); // resolved below
+		else if(arg=="--binsize" && hasvalue) binsize = atoi(argv[++i]);
+		else if(arg=="--connectivity" && hasvalue) connectivity = atoi(argv[++i]);
+		else if(arg=="--lambda" && hasvalue) lambda = atof(argv[++i]);
+		else if(arg=="--sweeps" && hasvalue) sweeps = atoi(argv[++i]);
+		else if(arg=="--arena" && hasvalue) arenafile = argv[++i];
+		else if(arg[0]!='-') positional.push_back(arg);
+		else {positional.clear(); break;}
+	}
+	if(positional.size()!=6){
+		cerr<<"usage: "<<argv[0]<<" image.ppm x1 y1 x2 y2 mask.pgm [--tile n | --budget MB] [--binsize n]"
+			" [--connectivity n] [--lambda w] [--sweeps n] [--arena file]"<<endl;
+		return 1;
+	}
+	if(tilesize<0) tilesize = TiledCut::tileSizeForBudget((size_t)(-tilesize)<<20, connectivity);
+
+	MappedPNM image, mask;
+	if(!image.open(positional[0].c_str()) || image.getChannels()!=3){
+		cerr<<"cannot map "<<positional[0]<<" as a binary PPM"<<endl;
+		return 1;
+	}
+	if(!mask.create(positional[5].c_str(), image.getWidth(), image.getHeight(), 1)){
+		cerr<<"cannot create "<<positional[5]<<endl;
+		return 1;
+	}
+	try{
+		MemArena arena(0, arenafile.empty() ? NULL : arenafile.c_str());
+		TiledCut tiled(tilesize, binsize, connectivity, lambda);
+		tiled.setArena(&arena);
+		tiled.setMaxRefinements(sweeps);
+
+		auto start = std::chrono::steady_clock::now();
+		if(tiled.run(image, atoi(positional[1].c_str()), atoi(positional[2].c_str()),
+			atoi(positional[3].c_str()), atoi(positional[4].c_str()), mask)<0){
+			cerr<<"the box is outside of the image"<<endl;
+			return 1;
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+		cout<<"image "<<image.getWidth()<<"x"<<image.getHeight()<<", tile "<<tilesize<<endl;
+		cout<<"windows "<<tiled.getNumWindows()<<", sweeps "<<1+tiled.getNumRefinements()
+			<<", pixels changed after the first sweep "<<tiled.getRefinedPixels()<<endl;
+		// the mask is a local minimum: its energy is within the gap of the optimum of OneCut
+		double gap = tiled.getEnergy()-tiled.getLowerBound();
+		cout<<"energy "<<(long long)tiled.getEnergy()<<", lower bound "<<(long long)tiled.getLowerBound()
+			<<", gap "<<(long long)gap<<" ("<<100*gap/max(tiled.getLowerBound(),1.0)<<"%)"<<endl;
+		cout<<"time "<<seconds<<" s, peak RSS "<<peakrss()/1024<<" MB, graph arena "<<arena.getCapacity()/(1<<20)<<" MB"<<endl;
+	}
+	catch(const std::bad_alloc &){
+		if(arenafile.empty()) cerr<<"out of memory"<<endl;
+		else cerr<<"out of memory or cannot grow the arena file "<<arenafile<<endl;
+		return 1;
+	}
+	return 0;
+}